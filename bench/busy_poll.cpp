@@ -0,0 +1,177 @@
+/*
+ * Busy-poll benchmark: ping-pong round trips over loopback, with and without
+ * set_busy_poll() on both ends. Reports round-trip latency percentiles and
+ * the CPU time (user + sys, both ends together) burned per round trip.
+ *
+ * Spinning only pays off when the two ends run on different CPUs; on a single
+ * CPU set_busy_poll() leaves the userspace spin off and only the kernel options
+ * apply (-f spins anyway, to show what that costs).
+ */
+
+#include <sys/resource.h>
+
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+
+#include "clientserver/clientserver.h"
+
+
+void echo(clientserver::service_buffer sock) {
+
+    try {
+
+        while (1) {
+            std::string line;
+            sock->read_until('\n', line);
+            sock->m_obj->send(line.data(), line.size());
+        }
+
+    } catch (clientserver::eof_exception& e) {
+        /* ... */
+
+    } catch (std::exception& e) {
+        logger::log(logger::ERROR) << "ERROR in serving : " << e.what();
+    }
+}
+
+
+unsigned long long cpu_usec() {
+
+    struct rusage ru;
+    ::getrusage(RUSAGE_SELF, &ru);
+
+    return (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000ULL + ru.ru_utime.tv_usec + ru.ru_stime.tv_usec;
+}
+
+
+void run(const std::string& host, unsigned int port, unsigned int spin, bool force, size_t iterations, size_t payload) {
+
+    // The serving thread outlives run(), so the listener is never freed.
+    clientserver::server_socket* server = new clientserver::server_socket(host, port);
+    server->set_busy_poll(spin);
+
+    if (force)
+        server->spin_usec = spin;
+
+    clientserver::serve(*server, echo, 16);
+
+    clientserver::client_buffer c = clientserver::connect(host, port, 5000, 5000);
+    c->m_obj->set_busy_poll(spin);
+
+    if (force)
+        c->m_obj->spin_usec = spin;
+
+    std::string msg(payload > 0 ? payload - 1 : 0, 'x');
+    msg += '\n';
+
+    std::vector<unsigned long long> rtt;
+    rtt.reserve(iterations);
+
+    unsigned long long cpu = 0;
+    unsigned long long wall = 0;
+
+    // The first tenth is warm-up.
+    for (size_t i = 0; i < iterations + iterations / 10; ++i) {
+
+        if (i == iterations / 10) {
+            cpu = cpu_usec();
+            wall = clientserver::monotonic_usec();
+        }
+
+        unsigned long long t0 = clientserver::monotonic_usec();
+
+        c->m_obj->send(msg.data(), msg.size());
+
+        std::string reply;
+        c->read_until('\n', reply);
+
+        if (i >= iterations / 10)
+            rtt.push_back(clientserver::monotonic_usec() - t0);
+    }
+
+    cpu = cpu_usec() - cpu;
+    wall = clientserver::monotonic_usec() - wall;
+
+    std::sort(rtt.begin(), rtt.end());
+
+    std::cout << std::setw(8) << spin << ' ' << std::setw(8) << c->m_obj->spin_usec
+              << ' ' << std::setw(10) << rtt[rtt.size() / 2]
+              << ' ' << std::setw(10) << rtt[rtt.size() * 99 / 100]
+              << ' ' << std::setw(10) << rtt[rtt.size() * 999 / 1000]
+              << ' ' << std::setw(10) << std::fixed << std::setprecision(2) << (double)wall / rtt.size()
+              << ' ' << std::setw(10) << std::fixed << std::setprecision(2) << (double)cpu / rtt.size()
+              << std::endl;
+}
+
+
+int main(int argc, char** argv) {
+
+    try {
+
+        std::string host = "127.0.0.1";
+        unsigned int port = 9877;
+        unsigned int spin = 50;
+        size_t iterations = 20000;
+        size_t payload = 64;
+        bool force = false;
+
+        while (1) {
+            int c = ::getopt(argc, argv, "h:p:s:n:b:f");
+
+            if (c == -1)
+                break;
+
+            switch (c) {
+            case 'h':
+                host = optarg;
+                break;
+
+            case 'p':
+                port = ::atoi(optarg);
+                break;
+
+            case 's':
+                spin = ::atoi(optarg);
+                break;
+
+            case 'n':
+                iterations = ::atoi(optarg);
+                break;
+
+            case 'b':
+                payload = ::atoi(optarg);
+                break;
+
+            case 'f':
+                force = true;
+                break;
+
+            default:
+                std::cout << "Usage: busy_poll -h <host> -p <port> -s <spin usec> -n <round trips> -b <payload bytes> [-f]"
+                          << std::endl
+                          << "  -f: spin in userspace even on a single CPU"
+                          << std::endl;
+                return 1;
+            }
+        }
+
+        if (iterations == 0)
+            iterations = 1;
+
+        std::cout << "cpus " << ::sysconf(_SC_NPROCESSORS_ONLN) << ", payload " << payload
+                  << " bytes, " << iterations << " round trips" << std::endl;
+
+        std::cout << "spin_req spin_eff    p50_us     p99_us    p999_us  wall_us/op   cpu_us/op" << std::endl;
+
+        run(host, port, 0, false, iterations, payload);
+        run(host, port + 1, spin, force, iterations, payload);
+
+    } catch (std::exception& e) {
+
+        std::cerr << "ERROR: " << e.what() << std::endl;
+        return 1;
+    }
+
+    ::_exit(0);
+}
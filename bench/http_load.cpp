@@ -0,0 +1,349 @@
+/*
+ * HTTP load generator: keep-alive connections, one thread each, with optional
+ * pipelining, for driving example.cpp-style servers over loopback.
+ *
+ * With a target rate (-r), every request has an intended start time on a fixed
+ * schedule, and latency is measured from that time: a stalled server delays the
+ * requests queued behind it, and those delays are counted (no coordinated omission).
+ * Without a rate the load is closed-loop (as fast as the server answers), and the
+ * corrected figures are back-filled the way HdrHistogram does it, with the mean
+ * latency as the expected interval.
+ *
+ * The payload goes into the query string (the server does not read request
+ * bodies); example.cpp echoes it back, so -b sets both directions.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <deque>
+
+#include "clientserver/clientserver.h"
+#include "httpd/httpd.h"
+#include "httpd/http-client.h"
+
+
+// httpd::client with the request and the response split, for pipelining.
+
+struct pipelined_client : public httpd::client {
+
+    pipelined_client(const std::string& host, int port, int rtimeout, int stimeout) :
+        httpd::client(host, port, rtimeout, stimeout) {}
+
+    void write(const std::string& req) {
+        m_sock << req;
+    }
+
+    void read(std::string& head, fields_t& fields, std::string& body) {
+        parse_response(head, fields, body);
+        check_reply_head(head);
+    }
+};
+
+
+struct config {
+    std::string host;
+    unsigned int port;
+    std::string path;
+
+    unsigned int connections;
+    unsigned int depth;
+    unsigned int rate;
+    unsigned int duration;
+    unsigned int warmup;
+    size_t payload;
+    unsigned int timeout;
+};
+
+
+struct result {
+
+    // Latency from the actual send, and from the intended one.
+    std::vector<unsigned long long> measured;
+    std::vector<unsigned long long> corrected;
+
+    unsigned long errors;
+
+    // Of the samples, requests that got no response.
+    unsigned long dropped;
+
+    result() : errors(0), dropped(0) {}
+};
+
+
+void run_connection(const config& cfg, const std::string& req, unsigned long long start, result& out) {
+
+    unsigned long long measure_from = start + cfg.warmup * 1000000ULL;
+    unsigned long long end = measure_from + cfg.duration * 1000000ULL;
+
+    // Per-connection schedule; 0 -- closed loop.
+    unsigned long long interval = (cfg.rate > 0 ? 1000000ULL * cfg.connections / cfg.rate : 0);
+    unsigned long long next = start;
+
+    boost::shared_ptr<pipelined_client> c;
+
+    // Outstanding requests: intended and actual send times.
+    std::deque<std::pair<unsigned long long, unsigned long long> > q;
+
+    std::string head;
+    httpd::client::fields_t fields;
+    std::string body;
+
+    while (1) {
+
+        unsigned long long now = clientserver::monotonic_usec();
+
+        if (now >= end && q.empty())
+            break;
+
+        try {
+
+            if (!c)
+                c.reset(new pipelined_client(cfg.host, cfg.port, cfg.timeout, cfg.timeout));
+
+            if (now < end && q.size() < cfg.depth && (interval == 0 || now >= next)) {
+
+                c->write(req);
+                q.push_back(std::make_pair(interval > 0 ? next : now, now));
+                next += interval;
+                continue;
+            }
+
+            if (q.empty()) {
+                ::usleep(std::min(next, end) - now);
+                continue;
+            }
+
+            head.clear();
+            fields.clear();
+            body.clear();
+
+            c->read(head, fields, body);
+
+            now = clientserver::monotonic_usec();
+
+            if (q.front().second >= measure_from) {
+                out.measured.push_back(now - q.front().second);
+                out.corrected.push_back(now - q.front().first);
+            }
+
+            q.pop_front();
+
+        } catch (std::exception& e) {
+
+            if (out.errors == 0)
+                std::cerr << "ERROR: " << e.what() << std::endl;
+
+            out.errors += (q.empty() ? 1 : q.size());
+
+            // The dropped requests waited at least this long (e.g. -T on a timeout):
+            // leaving them out would make a stalled server look faster.
+            unsigned long long now = clientserver::monotonic_usec();
+
+            for (size_t i = 0; i < q.size(); ++i) {
+
+                if (q[i].second >= measure_from) {
+                    out.measured.push_back(now - q[i].second);
+                    out.corrected.push_back(now - q[i].first);
+                    ++out.dropped;
+                }
+            }
+
+            q.clear();
+            c.reset();
+
+            // Down or refusing: do not spin on connect().
+            ::usleep(10000);
+        }
+    }
+}
+
+
+// HdrHistogram-style back-fill: a sample of v stood for the samples that would
+// have been taken every interval while it was in flight.
+
+void correct(std::vector<unsigned long long>& samples, unsigned long long interval) {
+
+    if (interval == 0)
+        return;
+
+    size_t n = samples.size();
+
+    for (size_t i = 0; i < n; ++i) {
+
+        for (unsigned long long v = samples[i]; v > interval; ) {
+            v -= interval;
+            samples.push_back(v);
+        }
+    }
+}
+
+
+void report(const char* name, std::vector<unsigned long long>& samples) {
+
+    std::cout << std::left << std::setw(10) << name << std::right;
+
+    if (samples.empty()) {
+        std::cout << " no samples" << std::endl;
+        return;
+    }
+
+    std::sort(samples.begin(), samples.end());
+
+    static const double pcts[] = { 50, 90, 99, 99.9, 99.99 };
+
+    for (size_t i = 0; i < sizeof(pcts) / sizeof(pcts[0]); ++i) {
+        size_t ix = (size_t)(samples.size() * pcts[i] / 100);
+        std::cout << ' ' << std::setw(10) << samples[std::min(ix, samples.size() - 1)];
+    }
+
+    std::cout << ' ' << std::setw(10) << samples.back() << std::endl;
+}
+
+
+int main(int argc, char** argv) {
+
+    try {
+
+        config cfg;
+        cfg.host = "127.0.0.1";
+        cfg.port = 9876;
+        cfg.path = "/";
+        cfg.connections = 16;
+        cfg.depth = 1;
+        cfg.rate = 0;
+        cfg.duration = 10;
+        cfg.warmup = 1;
+        cfg.payload = 0;
+        cfg.timeout = 5000;
+
+        while (1) {
+            int c = ::getopt(argc, argv, "h:p:u:c:d:r:t:w:b:T:");
+
+            if (c == -1)
+                break;
+
+            switch (c) {
+            case 'h':
+                cfg.host = optarg;
+                break;
+
+            case 'p':
+                cfg.port = ::atoi(optarg);
+                break;
+
+            case 'u':
+                cfg.path = optarg;
+                break;
+
+            case 'c':
+                cfg.connections = ::atoi(optarg);
+                break;
+
+            case 'd':
+                cfg.depth = ::atoi(optarg);
+                break;
+
+            case 'r':
+                cfg.rate = ::atoi(optarg);
+                break;
+
+            case 't':
+                cfg.duration = ::atoi(optarg);
+                break;
+
+            case 'w':
+                cfg.warmup = ::atoi(optarg);
+                break;
+
+            case 'b':
+                cfg.payload = ::atoi(optarg);
+                break;
+
+            case 'T':
+                cfg.timeout = ::atoi(optarg);
+                break;
+
+            default:
+                std::cout << "Usage: http_load -h <host> -p <port> -u <path> -c <connections> -d <pipelining depth> "
+                          << "-r <requests/sec, 0 -- closed loop> -t <seconds> -w <warm-up seconds> "
+                          << "-b <payload bytes> -T <socket timeout, msec>"
+                          << std::endl;
+                return 1;
+            }
+        }
+
+        if (cfg.connections == 0) cfg.connections = 1;
+        if (cfg.depth == 0) cfg.depth = 1;
+        if (cfg.duration == 0) cfg.duration = 1;
+
+        httpd::request r(cfg.host);
+        r.path = cfg.path;
+
+        if (cfg.payload > 0)
+            r.queries["payload"].push_back(std::string(cfg.payload, 'x'));
+
+        std::string req;
+        httpd::unparse_request(r, req);
+
+        std::cout << "http://" << cfg.host << ":" << cfg.port << cfg.path << ", " << cfg.connections << " connections, "
+                  << "depth " << cfg.depth << ", payload " << cfg.payload << " bytes, "
+                  << (cfg.rate > 0 ? files::format(cfg.rate) + " req/s" : std::string("closed loop")) << ", "
+                  << cfg.duration << " s (+" << cfg.warmup << " s warm-up)" << std::endl;
+
+        std::vector<result> results(cfg.connections);
+        boost::thread_group threads;
+
+        unsigned long long start = clientserver::monotonic_usec();
+
+        for (unsigned int i = 0; i < cfg.connections; ++i) {
+            threads.create_thread(boost::bind(&run_connection, boost::cref(cfg), boost::cref(req),
+                                              start, boost::ref(results[i])));
+        }
+
+        // Received bytes, for the measured window only.
+        ::usleep(cfg.warmup * 1000000ULL);
+        unsigned long long bytes = clientserver::stats::bytes_in().value();
+
+        threads.join_all();
+
+        bytes = clientserver::stats::bytes_in().value() - bytes;
+
+        result total;
+        unsigned long long sum = 0;
+
+        for (size_t i = 0; i < results.size(); ++i) {
+
+            total.measured.insert(total.measured.end(), results[i].measured.begin(), results[i].measured.end());
+            total.corrected.insert(total.corrected.end(), results[i].corrected.begin(), results[i].corrected.end());
+            total.errors += results[i].errors;
+            total.dropped += results[i].dropped;
+        }
+
+        for (size_t i = 0; i < total.measured.size(); ++i)
+            sum += total.measured[i];
+
+        if (cfg.rate == 0 && !total.measured.empty())
+            correct(total.corrected, sum / total.measured.size());
+
+        // Latencies include the dropped requests, the counts do not.
+        size_t n = total.measured.size() - total.dropped;
+
+        std::cout << "requests " << n << ", errors " << total.errors << std::endl;
+
+        std::cout << "throughput " << std::fixed << std::setprecision(1) << (double)n / cfg.duration << " req/s, "
+                  << std::setprecision(2) << (double)bytes / cfg.duration / (1024 * 1024) << " MB/s in" << std::endl;
+
+        std::cout << "latency_us        p50        p90        p99      p99.9     p99.99        max" << std::endl;
+
+        report("measured", total.measured);
+        report("corrected", total.corrected);
+
+    } catch (std::exception& e) {
+
+        std::cerr << "ERROR: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
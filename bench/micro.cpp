@@ -0,0 +1,409 @@
+/*
+ * Microbenchmarks for the hot paths: request parsing, number formatting and
+ * scanning, serialization and logging.
+ *
+ * Output is one line per benchmark in the Go testing format,
+ *
+ *   BenchmarkName  <iterations>  <ns> ns/op  <bytes> B/op  <allocs> allocs/op
+ *
+ * so runs from two commits can be compared with benchstat (use -c for repeated
+ * runs). Bytes and allocations are what operator new was asked for, per op.
+ */
+
+#include <stdlib.h>
+
+#include <iostream>
+#include <iomanip>
+#include <new>
+
+#include "clientserver/clientserver.h"
+#include "httpd/httpd.h"
+#include "files/serialization.h"
+#include "files/logger.h"
+
+
+// Allocation counting. The benchmarks run in one thread.
+
+static unsigned long long alloc_count = 0;
+static unsigned long long alloc_bytes = 0;
+
+// Kept out of line: inlined into the callers, the malloc() and free() below
+// would be seen pairing with new and delete (-Wmismatched-new-delete).
+
+__attribute__((noinline)) static void* counted_alloc(size_t n) {
+
+    ++alloc_count;
+    alloc_bytes += n;
+
+    void* p = ::malloc(n > 0 ? n : 1);
+
+    if (p == NULL)
+        throw std::bad_alloc();
+
+    return p;
+}
+
+__attribute__((noinline)) static void counted_free(void* p) {
+    ::free(p);
+}
+
+void* operator new(size_t n) {
+    return counted_alloc(n);
+}
+
+void* operator new[](size_t n) {
+    return counted_alloc(n);
+}
+
+void operator delete(void* p) throw() {
+    counted_free(p);
+}
+
+void operator delete[](void* p) throw() {
+    counted_free(p);
+}
+
+void operator delete(void* p, size_t) throw() {
+    counted_free(p);
+}
+
+void operator delete[](void* p, size_t) throw() {
+    counted_free(p);
+}
+
+
+// An endless stream that repeats data, for parsing from a clientserver::buffer.
+
+struct replay_socket {
+
+    const std::string& data;
+    size_t pos;
+
+    replay_socket(const std::string& d) : data(d), pos(0) {}
+
+    size_t recv(void* buff, size_t len) {
+
+        size_t n = std::min(len, data.size() - pos);
+        ::memcpy(buff, data.data() + pos, n);
+
+        pos = (pos + n) % data.size();
+        return n;
+    }
+
+    size_t recv_nowait(void* buff, size_t len) {
+        return recv(buff, len);
+    }
+
+    void send(const void*, size_t) {}
+    void sendv(struct iovec*, size_t, bool) {}
+};
+
+typedef boost::shared_ptr<clientserver::buffer<replay_socket> > replay_buffer;
+
+
+// Keeps the results alive, so that the compiler cannot drop the work.
+static volatile size_t sink = 0;
+
+
+/*** Inputs. ***/
+
+static const std::string browser_request =
+    "GET /search?q=hedged+requests&lang=en&page=2&utm_source=newsletter HTTP/1.1\r\n"
+    "Host: www.example.com\r\n"
+    "Connection: keep-alive\r\n"
+    "Cache-Control: max-age=0\r\n"
+    "sec-ch-ua: \"Chromium\";v=\"124\", \"Google Chrome\";v=\"124\", \"Not-A.Brand\";v=\"99\"\r\n"
+    "sec-ch-ua-mobile: ?0\r\n"
+    "sec-ch-ua-platform: \"Linux\"\r\n"
+    "Upgrade-Insecure-Requests: 1\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/124.0.0.0 Safari/537.36\r\n"
+    "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/avif,image/webp,*/*;q=0.8\r\n"
+    "Sec-Fetch-Site: same-origin\r\n"
+    "Sec-Fetch-Mode: navigate\r\n"
+    "Sec-Fetch-User: ?1\r\n"
+    "Sec-Fetch-Dest: document\r\n"
+    "Referer: https://www.example.com/search?q=tail+latency\r\n"
+    "Accept-Encoding: gzip, deflate, br\r\n"
+    "Accept-Language: en-US,en;q=0.9,ru;q=0.8\r\n"
+    "Cookie: session=8f14e45fceea167a5a36dedd4bea2543; prefs=lang%3Den%26tz%3DUTC; _ga=GA1.2.1234567890.1700000000\r\n"
+    "\r\n";
+
+static const std::string api_request =
+    "GET /v1/items?id=12345&fields=name,price HTTP/1.1\r\n"
+    "Host: api.internal\r\n"
+    "Accept: application/json\r\n"
+    "X-Request-Id: 3f2a9c1e-7b4d-4e8a-9f00-1c2d3e4f5a6b\r\n"
+    "\r\n";
+
+typedef std::map<std::string, std::vector<int> > index_t;
+typedef std::vector<std::pair<std::string, std::map<int, double> > > scores_t;
+
+static index_t make_index() {
+
+    index_t ret;
+
+    for (int i = 0; i < 16; ++i) {
+
+        std::vector<int>& v = ret["term" + files::format(i)];
+
+        for (int j = 0; j < 16; ++j)
+            v.push_back(i * 1000 + j * 37);
+    }
+
+    return ret;
+}
+
+static scores_t make_scores() {
+
+    scores_t ret;
+
+    for (int i = 0; i < 8; ++i) {
+
+        ret.push_back(std::make_pair("shard-" + files::format(i), std::map<int, double>()));
+
+        for (int j = 0; j < 8; ++j)
+            ret.back().second[j] = i + j / 8.0;
+    }
+
+    return ret;
+}
+
+static const index_t index_data = make_index();
+static const scores_t scores_data = make_scores();
+
+static std::string saved(const index_t& t) {
+    serialization::saver_string_policy p;
+    serialization::save(p, t);
+    return p.data;
+}
+
+static std::string saved(const scores_t& t) {
+    serialization::saver_string_policy p;
+    serialization::save(p, t);
+    return p.data;
+}
+
+static const std::string index_saved = saved(index_data);
+static const std::string scores_saved = saved(scores_data);
+
+
+/*** Benchmarks: one call is one op. ***/
+
+static replay_buffer browser_buf(new clientserver::buffer<replay_socket>(
+    boost::shared_ptr<replay_socket>(new replay_socket(browser_request))));
+
+static replay_buffer api_buf(new clientserver::buffer<replay_socket>(
+    boost::shared_ptr<replay_socket>(new replay_socket(api_request))));
+
+void parse_browser() {
+    httpd::request req;
+    httpd::parse_request(browser_buf, req);
+    sink += req.fields.size();
+}
+
+void parse_api() {
+    httpd::request req;
+    httpd::parse_request(api_buf, req);
+    sink += req.fields.size();
+}
+
+static std::string out;
+
+void format_int() {
+    out.clear();
+    files::format_numeric(out, 1234567890);
+    sink += out.size();
+}
+
+void format_int64_negative() {
+    out.clear();
+    files::format_numeric(out, -9876543210123LL);
+    sink += out.size();
+}
+
+void format_hex() {
+    out.clear();
+    files::format_numeric(out, 0xdeadbeefU, 16);
+    sink += out.size();
+}
+
+void format_double() {
+    out.clear();
+    files::format_real(out, 3.14159265358979, "%g");
+    sink += out.size();
+}
+
+void format_double_large() {
+    out.clear();
+    files::format_real(out, -123456789.000123, "%g");
+    sink += out.size();
+}
+
+static const std::string int_text = "1234567890";
+static const std::string int64_text = "-9876543210123";
+
+void scan_int() {
+    files::string_as_buffer b(int_text, '\n');
+    unsigned char la;
+    b >> la;
+
+    int t;
+    files::scan_numeric(b, t, la, "\n", 1);
+    sink += t;
+}
+
+void scan_int64() {
+    files::string_as_buffer b(int64_text, '\n');
+    unsigned char la;
+    b >> la;
+
+    long long t;
+    files::scan_numeric(b, t, la, "\n", 1);
+    sink += t;
+}
+
+void save_index() {
+    serialization::saver_string_policy p;
+    serialization::save(p, index_data);
+    sink += p.data.size();
+}
+
+void load_index() {
+    files::string_as_buffer b(index_saved);
+    index_t t;
+    serialization::load(b, t);
+    sink += t.size();
+}
+
+void save_scores() {
+    serialization::saver_string_policy p;
+    serialization::save(p, scores_data);
+    sink += p.data.size();
+}
+
+void load_scores() {
+    files::string_as_buffer b(scores_saved);
+    scores_t t;
+    serialization::load(b, t);
+    sink += t.size();
+}
+
+void log_enabled() {
+    logger::log(logger::INFO) << "GET " << "/v1/items" << "?" << "id=12345" << " took " << 1234 << " usec";
+}
+
+void log_disabled() {
+    logger::log(logger::DEBUG) << "GET " << "/v1/items" << "?" << "id=12345" << " took " << 1234 << " usec";
+}
+
+
+/*** Runner. ***/
+
+struct benchmark {
+    const char* name;
+    void (*f)();
+};
+
+static const benchmark benchmarks[] = {
+    { "ParseRequest/browser",       parse_browser },
+    { "ParseRequest/api",           parse_api },
+    { "FormatNumeric/int",          format_int },
+    { "FormatNumeric/int64_neg",    format_int64_negative },
+    { "FormatNumeric/hex",          format_hex },
+    { "FormatReal/double",          format_double },
+    { "FormatReal/double_large",    format_double_large },
+    { "ScanNumeric/int",            scan_int },
+    { "ScanNumeric/int64_neg",      scan_int64 },
+    { "Save/map_string_vector_int", save_index },
+    { "Load/map_string_vector_int", load_index },
+    { "Save/vector_pair_map",       save_scores },
+    { "Load/vector_pair_map",       load_scores },
+    { "Log/enabled",                log_enabled },
+    { "Log/disabled",               log_disabled },
+};
+
+
+// As in Go: grow the iteration count until one run takes benchtime.
+
+void run(const benchmark& b, unsigned long long benchtime) {
+
+    unsigned long long n = 1;
+
+    while (1) {
+
+        unsigned long long allocs = alloc_count;
+        unsigned long long bytes = alloc_bytes;
+        unsigned long long start = clientserver::monotonic_usec();
+
+        for (unsigned long long i = 0; i < n; ++i)
+            b.f();
+
+        unsigned long long elapsed = clientserver::monotonic_usec() - start;
+
+        if (elapsed >= benchtime || n >= 1000000000ULL) {
+
+            std::cout << "Benchmark" << std::left << std::setw(30) << b.name << std::right
+                      << ' ' << std::setw(10) << n
+                      << ' ' << std::setw(12) << std::fixed << std::setprecision(1) << elapsed * 1000.0 / n << " ns/op"
+                      << ' ' << std::setw(8) << (alloc_bytes - bytes) / n << " B/op"
+                      << ' ' << std::setw(6) << (alloc_count - allocs) / n << " allocs/op"
+                      << std::endl;
+            return;
+        }
+
+        unsigned long long next = (elapsed > 0 ? n * benchtime / elapsed * 6 / 5 : n * 100);
+
+        n = std::max(n + 1, std::min(next, n * 100));
+    }
+}
+
+
+int main(int argc, char** argv) {
+
+    unsigned long long benchtime = 1000;
+    unsigned int count = 1;
+    std::string filter;
+
+    while (1) {
+        int c = ::getopt(argc, argv, "t:c:f:");
+
+        if (c == -1)
+            break;
+
+        switch (c) {
+        case 't':
+            benchtime = ::atoi(optarg);
+            break;
+
+        case 'c':
+            count = ::atoi(optarg);
+            break;
+
+        case 'f':
+            filter = optarg;
+            break;
+
+        default:
+            std::cout << "Usage: micro -t <msec per benchmark> -c <runs of each> -f <name substring>" << std::endl;
+            return 1;
+        }
+    }
+
+    // Not set_logfiles(): that one redirects stdout and stderr themselves.
+    logger::set_thread_local_logfiles("/dev/null", "/dev/null");
+    logger::loglevels::disable(logger::DEBUG);
+
+    std::cout << "goos: linux" << std::endl
+              << "pkg: bench/micro" << std::endl;
+
+    for (size_t i = 0; i < sizeof(benchmarks) / sizeof(benchmarks[0]); ++i) {
+
+        if (!filter.empty() && std::string(benchmarks[i].name).find(filter) == std::string::npos)
+            continue;
+
+        for (unsigned int j = 0; j < count; ++j)
+            run(benchmarks[i], benchtime * 1000);
+    }
+
+    return 0;
+}
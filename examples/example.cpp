@@ -3,6 +3,8 @@
  * Could be potentially useful as a tool for debugging browsers. :)
  */
 
+#include <iostream>
+
 #include "clientserver/clientserver.h"
 #include "httpd/httpd.h"
 #include "util/util.h"
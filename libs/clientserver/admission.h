@@ -0,0 +1,435 @@
+#ifndef __CLIENTSERVER_ADMISSION_H
+#define __CLIENTSERVER_ADMISSION_H
+
+
+#include <time.h>
+#include <math.h>
+#include <poll.h>
+
+#include <string>
+#include <deque>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "clientserver.h"
+
+
+namespace clientserver {
+
+
+/*
+ *      .
+ *
+ *       ( ): 
+ *      ,  ;  
+ *    -  --  .
+ *
+ *       ,    
+ * (. timer_wheel.h): httpd::parse_request()  httpd::responder   ,
+ *      .     ,  
+ *  .
+ *
+ *    --      , --  
+ * : keep-alive      .  ,
+ *    ;      .
+ *
+ *    ,    ,   accept  .
+ *   --      .   
+ *    queue_timeout (  CoDel:  ,   
+ * ),       (  503)
+ *  send().
+ */
+
+class admission_control : public request_observer {
+
+    struct pending_ {
+        int client;
+        struct sockaddr_in peer;
+        unsigned long long deadline;
+    };
+
+    boost::mutex m_lock;
+
+    double m_limit;
+    double min_limit;
+    double max_limit;
+
+    //    , .
+    double long_rtt;
+
+    int inflight;
+    unsigned int queue_timeout;
+
+    std::deque<pending_> m_queue;
+
+    std::string reject_msg;
+
+    unsigned long admitted;
+    unsigned long queued;
+    unsigned long shed;
+
+    //     .   m_lock.
+    void update(double rtt) {
+
+        if (rtt < 1) rtt = 1;
+
+        if (long_rtt == 0) {
+            long_rtt = rtt;
+            return;
+        }
+
+        long_rtt = long_rtt * 0.995 + rtt * 0.005;
+
+        //  :    .
+        if (long_rtt / rtt > 2)
+            long_rtt *= 0.95;
+
+        //    --  .
+        if (inflight < m_limit / 2)
+            return;
+
+        double gradient = 1.5 * long_rtt / rtt;
+
+        if (gradient < 0.5) gradient = 0.5;
+        if (gradient > 1.0) gradient = 1.0;
+
+        double new_limit = m_limit * gradient + ::sqrt(m_limit);
+
+        m_limit = m_limit * 0.8 + new_limit * 0.2;
+
+        if (m_limit < min_limit) m_limit = min_limit;
+        if (m_limit > max_limit) m_limit = max_limit;
+    }
+
+    //     .   m_lock.
+    void expire_(unsigned long long now, std::vector<int>& stale) {
+
+        while (!m_queue.empty() && m_queue.front().deadline <= now) {
+            stale.push_back(m_queue.front().client);
+            m_queue.pop_front();
+            ++shed;
+        }
+    }
+
+    void reject_(const std::vector<int>& stale) {
+
+        for (std::vector<int>::const_iterator i = stale.begin(); i != stale.end(); ++i) {
+            reject(*i);
+        }
+    }
+
+public:
+
+    // queue_timeout  ; 0 --  . reject  --   .
+    admission_control(size_t initial = 64, size_t minl = 4, size_t maxl = 10000, unsigned int qtimeout = 5,
+                      const std::string& reject = "HTTP/1.1 503 Service Unavailable\r\n"
+                                                  "Content-Length: 0\r\n"
+                                                  "Connection: close\r\n"
+                                                  "Retry-After: 1\r\n\r\n") :
+        m_limit(initial), min_limit(minl), max_limit(maxl), long_rtt(0), inflight(0), queue_timeout(qtimeout),
+        reject_msg(reject), admitted(0), queued(0), shed(0) {}
+
+    ~admission_control() {
+        for (std::deque<pending_>::iterator i = m_queue.begin(); i != m_queue.end(); ++i) {
+            ::close(i->client);
+        }
+    }
+
+
+    //    .   --   
+    // admission_control:    (  next())    .
+    bool admit(int client, const struct sockaddr_in& peer) {
+
+        std::vector<int> stale;
+        bool ret = true;
+
+        {
+            boost::mutex::scoped_lock l(m_lock);
+
+            unsigned long long now = monotonic_usec();
+            expire_(now, stale);
+
+            if (m_queue.empty() && inflight < (int)m_limit) {
+                ++admitted;
+
+            } else if (queue_timeout > 0) {
+                pending_ p;
+                p.client = client;
+                p.peer = peer;
+                p.deadline = now + queue_timeout * 1000ULL;
+
+                m_queue.push_back(p);
+                ++queued;
+                ret = false;
+
+            } else {
+                stale.push_back(client);
+                ++shed;
+                ret = false;
+            }
+        }
+
+        reject_(stale);
+        return ret;
+    }
+
+    //   ,       (  peer),  -1.
+    int next(struct sockaddr_in& peer) {
+
+        std::vector<int> stale;
+        int ret = -1;
+
+        {
+            boost::mutex::scoped_lock l(m_lock);
+
+            expire_(monotonic_usec(), stale);
+
+            if (!m_queue.empty() && inflight < (int)m_limit) {
+                ret = m_queue.front().client;
+                peer = m_queue.front().peer;
+                m_queue.pop_front();
+
+                ++admitted;
+            }
+        }
+
+        reject_(stale);
+        return ret;
+    }
+
+    //     . ,  
+    //    ; -1 --  .
+    int expire() {
+
+        std::vector<int> stale;
+        int ret = -1;
+
+        {
+            boost::mutex::scoped_lock l(m_lock);
+
+            unsigned long long now = monotonic_usec();
+            expire_(now, stale);
+
+            if (!m_queue.empty())
+                ret = (m_queue.front().deadline - now + 999) / 1000;
+        }
+
+        reject_(stale);
+        return ret;
+    }
+
+    //   :   .
+    void request_started() {
+        boost::mutex::scoped_lock l(m_lock);
+        ++inflight;
+    }
+
+    //  :  . usec -- , .
+    void request_done(unsigned long long usec) {
+        boost::mutex::scoped_lock l(m_lock);
+        --inflight;
+        update(usec);
+    }
+
+    //  :    send(),  .
+    void reject(int client) {
+
+        if (!reject_msg.empty()) {
+            ::send(client, reject_msg.data(), reject_msg.size(), MSG_DONTWAIT | MSG_NOSIGNAL);
+            ::shutdown(client, SHUT_WR);
+
+            //     close()  RST,     .
+            char buff[4096];
+            while (::recv(client, buff, sizeof(buff), MSG_DONTWAIT) > 0)
+                ;
+        }
+
+        ::close(client);
+    }
+
+    size_t limit() {
+        boost::mutex::scoped_lock l(m_lock);
+        return m_limit;
+    }
+
+    size_t in_flight() {
+        boost::mutex::scoped_lock l(m_lock);
+        return inflight;
+    }
+
+    size_t queue_length() {
+        boost::mutex::scoped_lock l(m_lock);
+        return m_queue.size();
+    }
+
+    unsigned long admitted_count() {
+        boost::mutex::scoped_lock l(m_lock);
+        return admitted;
+    }
+
+    unsigned long queued_count() {
+        boost::mutex::scoped_lock l(m_lock);
+        return queued;
+    }
+
+    unsigned long shed_count() {
+        boost::mutex::scoped_lock l(m_lock);
+        return shed;
+    }
+};
+
+
+namespace {
+
+template <typename F>
+struct admitted_service_ {
+
+    F service;
+    admission_control* adm;
+    server_socket* server;
+    bool priority;
+
+    admitted_service_(F f, admission_control* a, server_socket* s, bool p) :
+        service(f), adm(a), server(s), priority(p) {}
+
+    //    .   --    .
+    void start(int client, struct sockaddr_in peer) {
+
+        while (client >= 0) {
+
+            try {
+                server->adopt(*this, client, peer, priority);
+                return;
+
+            } catch (std::exception& e) {
+                logger::log(logger::ERROR) << "ERROR in serving : " << e.what();
+
+            } catch (...) {
+                logger::log(logger::ERROR) << "UNKNOWN ERROR in serving";
+            }
+
+            ::close(client);
+            client = adm->next(peer);
+        }
+    }
+
+    //      ;  
+    //     .
+    struct observer_ : public request_observer {
+        admitted_service_& self;
+
+        observer_(admitted_service_& s) : self(s) {}
+
+        void request_started() {
+            self.adm->request_started();
+        }
+
+        void request_done(unsigned long long usec) {
+            self.adm->request_done(usec);
+
+            struct sockaddr_in peer;
+            self.start(self.adm->next(peer), peer);
+        }
+    };
+
+    void operator()(service_buffer b) {
+
+        //     () --    .
+        struct scoped_observe {
+            connection_timer& timer;
+
+            scoped_observe(connection_timer& t, request_observer* o) : timer(t) {
+                timer.observe(o);
+            }
+
+            ~scoped_observe() {
+                timer.observe(NULL);
+            }
+        };
+
+        observer_ o(*this);
+        scoped_observe so(b->m_obj->timer, &o);
+
+        service(b);
+    }
+};
+
+}
+
+
+//  serve_blocking(),   maxconns --  .
+
+template <typename F>
+inline void serve_admitted_blocking(server_socket& server, F service, admission_control& adm, bool priority = false) {
+
+    admitted_service_<F> as(service, &adm, &server, priority);
+
+    while (1) {
+
+        try {
+
+            //    - ,    ,     .
+            int timeout = adm.expire();
+
+            if (timeout >= 0) {
+                struct pollfd pfd;
+                pfd.fd = server.fd;
+                pfd.events = POLLIN;
+                pfd.revents = 0;
+
+                int n = ::poll(&pfd, 1, timeout);
+
+                if (n < 0 && errno != EINTR)
+                    throw error::system_error("could not poll() : ");
+
+                //   :  accept()  ,    ,    .
+                if (n <= 0)
+                    continue;
+            }
+
+            struct sockaddr_in peer;
+            int client = server.accept_client(peer);
+
+            if (adm.admit(client, peer))
+                as.start(client, peer);
+
+        } catch (std::exception& e) {
+            logger::log(logger::ERROR) << "ERROR in serving : " << e.what();
+
+        } catch (...) {
+            logger::log(logger::ERROR) << "UNKNOWN ERROR in serving";
+        }
+    }
+}
+
+template <typename F>
+inline void serve_admitted(server_socket& server, F service, admission_control& adm, bool priority = false) {
+
+    boost::thread th(boost::bind<void>(&serve_admitted_blocking<F>,
+                                       boost::ref(server), service, boost::ref(adm), priority));
+}
+
+}
+
+/*
+
+    :
+
+     server_socket server("0.0.0.0", 9876);
+
+     //   64  ,   8  2000,
+     //      5 .
+     static admission_control adm(64, 8, 2000, 5);
+     serve_admitted(server, service, adm);
+
+     ...
+     logger::log(logger::INFO) << "limit " << adm.limit() << " queue " << adm.queue_length()
+                               << " shed " << adm.shed_count();
+
+ */
+
+
+#endif
@@ -0,0 +1,235 @@
+#ifndef __CLIENTSERVER_AFFINITY_H
+#define __CLIENTSERVER_AFFINITY_H
+
+
+#include <sched.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <stdlib.h>
+
+#include <string>
+#include <vector>
+
+#include "util/glob.h"
+#include "lockfree/aux_.h"
+
+#include "clientserver.h"
+
+
+namespace clientserver {
+
+
+//     : "0-3,8,10-11".
+
+inline std::vector<int> parse_cpu_list(const std::string& s) {
+
+    std::vector<int> ret;
+    const char* p = s.c_str();
+
+    while (*p != '\0') {
+
+        char* e;
+        long a = ::strtol(p, &e, 10);
+
+        if (e == p) {
+            ++p;
+            continue;
+        }
+
+        long b = a;
+        p = e;
+
+        if (*p == '-') {
+            ++p;
+            b = ::strtol(p, &e, 10);
+            p = e;
+        }
+
+        for (long i = a; i <= b; ++i) {
+            ret.push_back(i);
+        }
+    }
+
+    return ret;
+}
+
+
+inline void set_cpu_affinity(const std::vector<int>& cpus) {
+
+    if (cpus.empty()) return;
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+
+    for (std::vector<int>::const_iterator i = cpus.begin(); i != cpus.end(); ++i) {
+        CPU_SET(*i, &set);
+    }
+
+    int tmp = ::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set);
+
+    if (tmp != 0)
+        logger::log(logger::ERROR) << "WARNING: could not pthread_setaffinity_np() : " << tmp;
+}
+
+
+namespace {
+
+inline std::string read_sysfs_(const std::string& path) {
+
+    std::string ret;
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+
+    if (fd < 0) return ret;
+
+    char buff[4096];
+    ssize_t n = ::read(fd, buff, sizeof(buff));
+
+    if (n > 0)
+        ret.assign(buff, n);
+
+    ::close(fd);
+    return ret;
+}
+
+}
+
+
+//  NUMA-,   /sys.  /sys  --     .
+//     ,    node/online;   
+// ( ) .
+
+inline std::vector<std::vector<int> > numa_nodes() {
+
+    std::vector<std::vector<int> > ret;
+    std::vector<int> ids = parse_cpu_list(read_sysfs_("/sys/devices/system/node/online"));
+
+    for (std::vector<int>::const_iterator i = ids.begin(); i != ids.end(); ++i) {
+
+        std::vector<int> cpus = parse_cpu_list(read_sysfs_("/sys/devices/system/node/node" + files::format(*i) + "/cpulist"));
+
+        if (cpus.empty()) continue;
+
+        ret.push_back(cpus);
+    }
+
+    if (ret.empty()) {
+        long ncpu = ::sysconf(_SC_NPROCESSORS_ONLN);
+
+        ret.push_back(std::vector<int>());
+
+        for (long i = 0; i < (ncpu > 0 ? ncpu : 1); ++i) {
+            ret.back().push_back(i);
+        }
+    }
+
+    return ret;
+}
+
+
+
+/*
+ *    .
+ *
+ *          
+ * (    NUMA-).     
+ *  ,         
+ * (first touch).
+ */
+
+class placement {
+
+    std::vector<std::vector<int> > groups;
+    std::vector<int> group_node;
+
+    std::vector<long> active;
+    std::vector<unsigned long> total;
+
+    placement() {}
+
+    static int node_of_(const std::vector<std::vector<int> >& nodes, int cpu) {
+
+        for (size_t n = 0; n < nodes.size(); ++n) {
+            for (size_t i = 0; i < nodes[n].size(); ++i) {
+                if (nodes[n][i] == cpu) return n;
+            }
+        }
+
+        return 0;
+    }
+
+public:
+
+    //   --     ,  .
+    static placement cores(const std::vector<int>& cpus) {
+
+        std::vector<std::vector<int> > nodes = numa_nodes();
+        placement ret;
+
+        for (std::vector<int>::const_iterator i = cpus.begin(); i != cpus.end(); ++i) {
+            ret.groups.push_back(std::vector<int>(1, *i));
+            ret.group_node.push_back(node_of_(nodes, *i));
+        }
+
+        ret.active.resize(nodes.size(), 0);
+        ret.total.resize(nodes.size(), 0);
+        return ret;
+    }
+
+    static placement cores(const std::string& cpulist) {
+        return cores(parse_cpu_list(cpulist));
+    }
+
+    //     NUMA-,    .
+    static placement numa() {
+
+        placement ret;
+        ret.groups = numa_nodes();
+
+        for (size_t n = 0; n < ret.groups.size(); ++n) {
+            ret.group_node.push_back(n);
+        }
+
+        ret.active.resize(ret.groups.size(), 0);
+        ret.total.resize(ret.groups.size(), 0);
+        return ret;
+    }
+
+    size_t nodes() const {
+        return active.size();
+    }
+
+    //      n;   NUMA-.
+    int bind_thread(unsigned int n) {
+
+        if (groups.empty()) return 0;
+
+        size_t g = n % groups.size();
+        set_cpu_affinity(groups[g]);
+        return group_node[g];
+    }
+
+    void connection_opened(int node) {
+        lockfree::atomic_add(&(active[node]), 1L);
+        lockfree::atomic_add(&(total[node]), 1UL);
+    }
+
+    void connection_closed(int node) {
+        lockfree::atomic_add(&(active[node]), -1L);
+    }
+
+    long active_connections(int node) {
+        return lockfree::atomic_add(&(active[node]), 0L);
+    }
+
+    unsigned long total_connections(int node) {
+        return lockfree::atomic_add(&(total[node]), 0UL);
+    }
+};
+
+
+}
+
+
+#endif
@@ -27,6 +27,7 @@
 #include <boost/bind.hpp>
 #include <boost/bind/protect.hpp>
 #include <boost/thread.hpp>
+#include <boost/make_shared.hpp>
 
 
 #include "error/error.h"
@@ -34,6 +35,9 @@
 #include "files/logger.h"
 
 #include "clientserver_base.h"
+#include "freelist.h"
+#include "timer_wheel.h"
+#include "stats.h"
 
 #include "lockfree/aux_.h"
 
@@ -58,6 +62,15 @@ struct send_error: public std::runtime_error {
     {}
 };
 
+//   (. unknown_socket::set_deadline).    --  .
+class deadline_exceeded : public std::exception {
+public:
+
+    const char* what() const throw() {
+        return "deadline exceeded";
+    }
+};
+
 /*
  * , , .
  *
@@ -77,10 +90,95 @@ protected:
         throw err;
     }
 
+    //   ,    deadline.    .
+    void wait_(short events) {
+
+        while (1) {
+
+            int timeout = -1;
+
+            if (deadline > 0) {
+                unsigned long long now = monotonic_usec();
+
+                if (now >= deadline)
+                    throw deadline_exceeded();
+
+                timeout = (deadline - now + 999) / 1000;
+            }
+
+            struct pollfd pfd;
+            pfd.fd = fd;
+            pfd.events = events;
+            pfd.revents = 0;
+
+            int tmp = ::poll(&pfd, 1, timeout);
+
+            if (tmp > 0)
+                return;
+
+            if (tmp < 0 && errno != EINTR)
+                throw error::system_error("could not poll() : ");
+        }
+    }
+
+    // EAGAIN:    ,     SO_SNDTIMEO/SO_RCVTIMEO.
+    bool again_(short events) {
+
+        if (errno == EINTR)
+            return true;
+
+        if (nonblocking && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            wait_(events);
+            return true;
+        }
+
+        return false;
+    }
+
+    //    recv()  spin_usec,    .
+    // 0 --     ,  --  .
+    size_t spin_recv_(void* buff, size_t len) {
+
+        unsigned long long until = monotonic_usec() + spin_usec;
+
+        if (deadline > 0 && deadline < until)
+            until = deadline;
+
+        do {
+            ssize_t tmp = ::recv(fd, buff, len, MSG_DONTWAIT);
+
+            if (tmp > 0) {
+                stats::bytes_in().add(tmp);
+                return tmp;
+            }
+
+            if (tmp == 0)
+                throw eof_exception();
+
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                throw recv_error("could not recv() : " + error::strerror());
+
+        } while (monotonic_usec() < until);
+
+        return 0;
+    }
+
 public:
     int fd;
 
-    unknown_socket(int f) : fd(f) {}
+    //  : send()  recv()    poll()  deadline.
+    bool nonblocking;
+
+    //    monotonic_usec(); 0 --  .
+    unsigned long long deadline;
+
+    //   -- send()/recv()    (. uring.h).
+    boost::shared_ptr<io_backend> backend;
+
+    //   recv() ,    (. set_busy_poll()).
+    unsigned int spin_usec;
+
+    unknown_socket(int f) : fd(f), nonblocking(false), deadline(0), spin_usec(0) {}
 
     ~unknown_socket() {
         if (fd < 0) return;
@@ -88,26 +186,238 @@ public:
         ::close(fd);
     }
 
+    void set_nonblocking(bool on) {
+
+        int flags = ::fcntl(fd, F_GETFL, 0);
+
+        if (flags < 0)
+            throw error::system_error("could not fcntl(F_GETFL) : ");
+
+        flags = (on ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK));
+
+        if (::fcntl(fd, F_SETFL, flags) < 0)
+            throw error::system_error("could not fcntl(F_SETFL) : ");
+
+        nonblocking = on;
+    }
+
+    //   :     .  
+    //     (SO_BUSY_POLL, SO_PREFER_BUSY_POLL;  CAP_NET_ADMIN),
+    //  recv()  usec     ,   
+    //   .      --  .
+    // 0 -- .
+
+    void set_busy_poll(unsigned int usec) {
+
+        int tmp = usec;
+
+        if (::setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &tmp, sizeof(tmp)) < 0)
+            logger::log(logger::ERROR) << "WARNING: setsockopt(SO_BUSY_POLL) failed. (" << usec << ")";
+
+#ifdef SO_PREFER_BUSY_POLL
+        tmp = (usec > 0 ? 1 : 0);
+
+        if (::setsockopt(fd, SOL_SOCKET, SO_PREFER_BUSY_POLL, &tmp, sizeof(tmp)) < 0)
+            logger::log(logger::ERROR) << "WARNING: setsockopt(SO_PREFER_BUSY_POLL) failed. (" << tmp << ")";
+#endif
+
+        static long cpus = ::sysconf(_SC_NPROCESSORS_ONLN);
+        spin_usec = (cpus > 1 ? usec : 0);
+    }
+
+    //     ,     recv()  .
+    // timeout     ; 0 --  .
+    void set_deadline(unsigned int timeout) {
+        deadline = (timeout > 0 ? monotonic_usec() + timeout * 1000ULL : 0);
+    }
+
+    //    send()/recv() (. zerocopy.h):   ,   errno.
+    //   send()/recv(): EINTR,     -- EAGAIN    deadline.
+    bool retry(short events) {
+        return again_(events);
+    }
+
     void send(const void* data, size_t len) {
-        ssize_t tmp = ::send(fd, data, len, MSG_NOSIGNAL);
 
-        if (tmp < 0 || tmp != (ssize_t)len)
+        stats::bytes_out().add(len);
+
+        if (backend) {
+            backend->send(data, len);
+            return;
+        }
+
+        const char* p = (const char*)data;
+
+        while (len > 0) {
+
+            ssize_t tmp = ::send(fd, p, len, MSG_NOSIGNAL);
+
+            if (tmp < 0) {
+                if (again_(POLLOUT))
+                    continue;
+
+                throw send_error("could not send() : " + error::strerror());
+            }
+
+            p += tmp;
+            len -= tmp;
+        }
+    }
+
+    //  : ,  ,    (  0).
+    size_t send_nowait(const void* data, size_t len) {
+
+        if (backend) {
+            stats::bytes_out().add(len);
+            backend->send(data, len);
+            return len;
+        }
+
+        ssize_t tmp = ::send(fd, data, len, MSG_DONTWAIT | MSG_NOSIGNAL);
+
+        if (tmp < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+                return 0;
+
             throw send_error("could not send() : " + error::strerror());
+        }
+
+        stats::bytes_out().add(tmp);
+        return tmp;
+    }
+
+    //  : iov  (   ).
+    void sendv(struct iovec* iov, size_t n, bool more) {
+
+        size_t total = 0;
+
+        for (size_t i = 0; i < n; ++i)
+            total += iov[i].iov_len;
+
+        stats::bytes_out().add(total);
+
+        if (backend) {
+            backend->sendv(iov, n, more);
+            return;
+        }
+
+        struct msghdr msg;
+        ::memset(&msg, 0, sizeof(msg));
+
+        while (n > 0) {
+
+            msg.msg_iov = iov;
+            msg.msg_iovlen = n;
+
+            ssize_t tmp = ::sendmsg(fd, &msg, MSG_NOSIGNAL | (more ? MSG_MORE : 0));
+
+            if (tmp < 0) {
+                if (again_(POLLOUT))
+                    continue;
+
+                throw send_error("could not sendmsg() : " + error::strerror());
+            }
+
+            while (n > 0 && (size_t)tmp >= iov->iov_len) {
+                tmp -= iov->iov_len;
+                ++iov;
+                --n;
+            }
+
+            if (n > 0) {
+                iov->iov_base = (char*)iov->iov_base + tmp;
+                iov->iov_len -= tmp;
+            }
+        }
+    }
+
+    //    : ,  ,    (  0).
+    size_t sendv_nowait(struct iovec* iov, size_t n, bool more) {
+
+        if (backend) {
+            size_t total = 0;
+
+            for (size_t i = 0; i < n; ++i)
+                total += iov[i].iov_len;
+
+            stats::bytes_out().add(total);
+            backend->sendv(iov, n, more);
+            return total;
+        }
+
+        struct msghdr msg;
+        ::memset(&msg, 0, sizeof(msg));
+
+        msg.msg_iov = iov;
+        msg.msg_iovlen = n;
+
+        ssize_t tmp = ::sendmsg(fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL | (more ? MSG_MORE : 0));
+
+        if (tmp < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+                return 0;
+
+            throw send_error("could not sendmsg() : " + error::strerror());
+        }
+
+        stats::bytes_out().add(tmp);
+        return tmp;
     }
 
     size_t recv(void* buff, size_t len) {
-        int tmp = 0;
-        tmp = ::recv(fd, buff, len, 0);
 
-        if (tmp < 0)
-            throw recv_error("could not recv() : " + error::strerror());
+        if (backend) {
+            size_t ret = backend->recv(buff, len);
+            stats::bytes_in().add(ret);
+            return ret;
+        }
+
+        if (spin_usec > 0) {
+            size_t ret = spin_recv_(buff, len);
+
+            if (ret > 0)
+                return ret;
+        }
+
+        ssize_t tmp = 0;
+
+        while ((tmp = ::recv(fd, buff, len, 0)) < 0) {
+
+            if (!again_(POLLIN))
+                throw recv_error("could not recv() : " + error::strerror());
+        }
 
         if (tmp == 0)
             throw eof_exception();
 
+        stats::bytes_in().add(tmp);
         return tmp;
     }
 
+    //  :   ,  0.
+    size_t recv_nowait(void* buff, size_t len) {
+
+        if (backend) {
+            size_t ret = backend->recv_nowait(buff, len);
+            stats::bytes_in().add(ret);
+            return ret;
+        }
+
+        ssize_t tmp = ::recv(fd, buff, len, MSG_DONTWAIT);
+
+        if (tmp < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+                return 0;
+
+            throw recv_error("could not recv() : " + error::strerror());
+        }
+
+        if (tmp == 0)
+            throw eof_exception();
+
+        stats::bytes_in().add(tmp);
+        return tmp;
+    }
 
 
     std::pair<std::string,int> getname(bool peer) {
@@ -159,13 +469,231 @@ public:
 
 class service_socket : public unknown_socket {
 
+    //      accept(),      getpeername().
+    struct sockaddr_in peer;
 
 public:
     unsigned int thread_number;
 
-    service_socket(int f, unsigned int tn) : unknown_socket(f), thread_number(tn) {}
+    //  ,     (. server_socket::set_timeouts()).
+    connection_timer timer;
+
+    service_socket(int f, unsigned int tn) : unknown_socket(f), thread_number(tn), timer(fd) {
+        peer.sin_family = AF_UNSPEC;
+    }
+
+    service_socket(int f, unsigned int tn, const struct sockaddr_in& p) : unknown_socket(f), peer(p), thread_number(tn), timer(fd) {}
+
+    std::pair<std::string,int> getpeername() {
+
+        if (peer.sin_family != AF_INET)
+            return unknown_socket::getpeername();
+
+        char buff[INET_ADDRSTRLEN];
+
+        if (::inet_ntop(AF_INET, (void*)(&peer.sin_addr), buff, INET_ADDRSTRLEN) == NULL)
+            throw error::system_error("could not inet_ntop()");
+
+        return std::make_pair(buff, ntohs(peer.sin_port));
+    }
+};
+
+
+//  : ,    .
+typedef boost::shared_ptr<buffer<service_socket> > service_buffer;
+
+
+//  : ,       ,
+//      (. freelist.h).     --
+//   connection,  service_buffer  connection.
+
+struct connection {
+    service_socket sock;
+    buffer<service_socket> buf;
+
+    connection(int fd, unsigned int tn, const struct sockaddr_in& peer) :
+        sock(fd, tn, peer), buf(boost::shared_ptr<service_socket>(boost::shared_ptr<void>(), &sock)) {
+
+        stats::active().add(1);
+    }
+
+    ~connection() {
+        stats::active().add(-1);
+    }
 };
 
+inline service_buffer make_connection(int fd, unsigned int tn, const struct sockaddr_in& peer) {
+
+    boost::shared_ptr<connection> c = boost::allocate_shared<connection>(freelist_allocator<connection>(), fd, tn, peer);
+    return service_buffer(c, &(c->buf));
+}
+
+
+
+//      . ( ulimit -r.)
+
+inline void set_realtime_priority() {
+
+    struct sched_param param;
+    param.sched_priority = 1;
+
+    int tmp = ::pthread_setschedparam(::pthread_self(), SCHED_RR, &param);
+
+    if (tmp != 0) {
+        logger::log(logger::FATAL) << "Could not pthread_setschedparam() : " << tmp;
+        abort();
+    }
+}
+
+//      .
+
+inline void set_cpu_affinity(int cpu) {
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+
+    int tmp = ::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set);
+
+    if (tmp != 0)
+        logger::log(logger::ERROR) << "WARNING: could not pthread_setaffinity_np(" << cpu << ") : " << tmp;
+}
+
+
+
+//   unix-:    MAX_PASSED_FDS  (SCM_RIGHTS)
+//  sendmsg().  SOCK_SEQPACKET   ;  SOCK_STREAM --
+// ,        .   :
+//     ,        .
+
+static const size_t MAX_PASSED_FDS = 16;
+
+inline void send_message(int sock, const void* data, size_t len, const int* fds, size_t nfds) {
+
+    if (len == 0)
+        throw send_error("send_message(): empty message");
+
+    if (nfds > MAX_PASSED_FDS)
+        throw send_error("send_message(): too many descriptors");
+
+    struct iovec iov;
+    iov.iov_base = (void*)data;
+    iov.iov_len = len;
+
+    char cbuf[CMSG_SPACE(sizeof(int) * MAX_PASSED_FDS)];
+    ::memset(cbuf, 0, sizeof(cbuf));
+
+    struct msghdr msg;
+    ::memset(&msg, 0, sizeof(msg));
+
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+
+    if (nfds > 0) {
+        msg.msg_control = cbuf;
+        msg.msg_controllen = CMSG_SPACE(sizeof(int) * nfds);
+
+        struct cmsghdr* cm = CMSG_FIRSTHDR(&msg);
+        cm->cmsg_level = SOL_SOCKET;
+        cm->cmsg_type = SCM_RIGHTS;
+        cm->cmsg_len = CMSG_LEN(sizeof(int) * nfds);
+        ::memcpy(CMSG_DATA(cm), fds, sizeof(int) * nfds);
+    }
+
+    ssize_t tmp;
+
+    while ((tmp = ::sendmsg(sock, &msg, MSG_NOSIGNAL)) < 0 && errno == EINTR)
+        ;
+
+    if (tmp < 0)
+        throw send_error("could not sendmsg() : " + error::strerror());
+
+    if ((size_t)tmp != len)
+        throw send_error("sendmsg(): message sent partially");
+}
+
+//    ;  --  fds,   .
+// ,    buff (SOCK_SEQPACKET)    , -- .
+
+inline size_t recv_message(int sock, void* buff, size_t len, std::vector<int>& fds) {
+
+    fds.clear();
+
+    struct iovec iov;
+    iov.iov_base = buff;
+    iov.iov_len = len;
+
+    char cbuf[CMSG_SPACE(sizeof(int) * MAX_PASSED_FDS)];
+
+    struct msghdr msg;
+    ::memset(&msg, 0, sizeof(msg));
+
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = cbuf;
+    msg.msg_controllen = sizeof(cbuf);
+
+    ssize_t tmp;
+
+    while ((tmp = ::recvmsg(sock, &msg, MSG_CMSG_CLOEXEC)) < 0 && errno == EINTR)
+        ;
+
+    if (tmp < 0)
+        throw recv_error("could not recvmsg() : " + error::strerror());
+
+    if (tmp == 0)
+        throw eof_exception();
+
+    for (struct cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm != NULL; cm = CMSG_NXTHDR(&msg, cm)) {
+
+        if (cm->cmsg_level != SOL_SOCKET || cm->cmsg_type != SCM_RIGHTS)
+            continue;
+
+        size_t n = (cm->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        size_t old = fds.size();
+
+        if (n == 0)
+            continue;
+
+        fds.resize(old + n);
+        ::memcpy(&fds[old], CMSG_DATA(cm), sizeof(int) * n);
+    }
+
+    if (msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC)) {
+
+        for (size_t i = 0; i < fds.size(); ++i)
+            ::close(fds[i]);
+
+        fds.clear();
+        throw recv_error("recvmsg(): message truncated");
+    }
+
+    return tmp;
+}
+
+
+//      tag.
+
+inline void send_fd(int sock, int fd, char tag) {
+    send_message(sock, &tag, 1, &fd, 1);
+}
+
+//   ,  -1,     .
+
+inline int recv_fd(int sock, char& tag) {
+
+    std::vector<int> fds;
+    recv_message(sock, &tag, 1, fds);
+
+    if (fds.empty())
+        return -1;
+
+    for (size_t i = 1; i < fds.size(); ++i)
+        ::close(fds[i]);
+
+    return fds[0];
+}
+
 
 
 //  :  bind  listen  ;
@@ -179,12 +707,21 @@ protected:
 
     int thread_count;
 
+    //   - (. handoff.h); -1,      .
+    int handoff_fd;
+
     const unsigned int rcv_timeout;
     const unsigned int snd_timeout;
 
+    //  ; NULL --  .
+    timer_wheel* wheel;
+    connection_timeouts timeouts;
     //  .
     bool do_setopts;
 
+    //  TCP Fast Open (. set_fastopen()).
+    bool fastopen;
+
     struct scoped_counter {
         server_socket& self;
         int count;
@@ -238,44 +775,39 @@ protected:
 
 
     template <typename F>
-    void run(F& f, int client, bool priority) {
+    void run(F& f, int client, struct sockaddr_in peer, bool priority) {
 
         if (do_setopts)
             setopts(client);
 
-        if (priority) {
-
-            struct sched_param param;
-            param.sched_priority = 1;
-
-            int tmp = ::pthread_setschedparam(::pthread_self(), SCHED_RR, &param);
-
-            if (tmp != 0) {
-                logger::log(logger::FATAL) << "Could not pthread_setschedparam() : " << tmp;
-                abort();
-            }
-        }
+        if (priority)
+            set_realtime_priority();
 
         scoped_counter sc(*this);
 
-        boost::shared_ptr<service_socket> s(new service_socket(client, sc.count));
-        boost::shared_ptr<buffer<service_socket> > b(new buffer<service_socket>(s));
-
         // Exception-safe
 
+        service_buffer b = make_connection(client, sc.count, peer);
+        watch(b);
+
         f(b);
     }
 
 
     server_socket(unsigned int rtimeout, unsigned int stimeout, bool setop) :
-        unknown_socket(-1), thread_count(0), rcv_timeout(rtimeout), snd_timeout(stimeout), do_setopts(setop)
+        unknown_socket(-1), thread_count(0), handoff_fd(-1), rcv_timeout(rtimeout), snd_timeout(stimeout),
+        wheel(NULL), do_setopts(setop), fastopen(false)
         {}
 
 
 public:
 
-    server_socket(const std::string& host, int port, unsigned int rtimeout = 0, unsigned int stimeout = 0) :
-        unknown_socket(-1), thread_count(0), rcv_timeout(rtimeout), snd_timeout(stimeout), do_setopts(true) {
+    // reuseport:         (. reuseport.h).
+
+    server_socket(const std::string& host, int port, unsigned int rtimeout = 0, unsigned int stimeout = 0,
+                  bool reuseport = false) :
+        unknown_socket(-1), thread_count(0), handoff_fd(-1), rcv_timeout(rtimeout), snd_timeout(stimeout),
+        wheel(NULL), do_setopts(false), fastopen(false) {
 
         fd = ::socket(AF_INET, SOCK_STREAM, 0);
 
@@ -285,9 +817,16 @@ public:
         if (::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &is_true, sizeof(is_true)) < 0)
             teardown("could not setsockopt(SO_REUSEADDR) : ");
 
+        if (reuseport && ::setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &is_true, sizeof(is_true)) < 0)
+            teardown("could not setsockopt(SO_REUSEPORT) : ");
+
         if (::setsockopt(fd, SOL_TCP, TCP_NODELAY, &is_true, sizeof(is_true)) < 0)
             teardown("could not setsockopt(TCP_NODELAY) : ");
 
+        //   accept()    ,
+        //       ,     .
+        setopts(fd);
+
         struct sockaddr_in addr;
         ::memset(&addr, 0, sizeof(addr));
 
@@ -307,6 +846,153 @@ public:
     }
 
 
+    //  accept()  ,     .
+    // (      seconds .)
+
+    void set_defer_accept(int seconds) {
+        if (::setsockopt(fd, SOL_TCP, TCP_DEFER_ACCEPT, &seconds, sizeof(seconds)) < 0)
+            logger::log(logger::ERROR) << "WARNING: setsockopt(TCP_DEFER_ACCEPT) failed. (" << seconds << ")";
+    }
+
+
+    // TCP Fast Open:     SYN,   ; qlen --
+    //      accept().  net.ipv4.tcp_fastopen & 2.
+    //   cookie    .
+
+    void set_fastopen(int qlen) {
+        if (::setsockopt(fd, SOL_TCP, TCP_FASTOPEN, &qlen, sizeof(qlen)) < 0) {
+            logger::log(logger::ERROR) << "WARNING: setsockopt(TCP_FASTOPEN) failed. (" << qlen << ")";
+            return;
+        }
+
+        fastopen = true;
+    }
+
+
+    //  ,  ,    :  close(),  shutdown().
+    ~server_socket() {
+        if (handed_off()) {
+            ::close(fd);
+            fd = -1;
+        }
+    }
+
+
+    //     (. evented.h).
+    //      (. handoff.h) ,  
+    //  ,    --     .
+
+    int accept_client(struct sockaddr_in& peer) {
+
+        while (1) {
+
+            socklen_t alen = sizeof(peer);
+            int client = ::accept4(fd, (struct sockaddr*)&peer, &alen, SOCK_CLOEXEC);
+
+            if (client >= 0) {
+                count_accepted(client);
+
+                if (handed_off()) {
+                    scoped_counter sc(*this);
+                    hand_off(client);
+                    continue;
+                }
+
+                return client;
+            }
+
+            // SO_RCVTIMEO      accept().
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+                continue;
+
+            throw error::system_error("could not accept() : ");
+        }
+    }
+
+    //      ( Fast Open,   ).
+    void count_accepted(int client) {
+
+        stats::accepted().add();
+
+        if (!fastopen)
+            return;
+
+        tcp_info inf;
+        socklen_t tmp = sizeof(inf);
+
+        if (::getsockopt(client, IPPROTO_TCP, TCP_INFO, (void*)&inf, &tmp) == 0 &&
+            (inf.tcpi_options & TCPI_OPT_SYN_DATA)) {
+
+            stats::fastopen_accepted().add();
+        }
+    }
+
+    void setup_client(int client) {
+        if (do_setopts)
+            setopts(client);
+    }
+
+    //     ,     (. timer_wheel.h).
+    //   serve().
+    void set_timeouts(timer_wheel& w, const connection_timeouts& t) {
+        wheel = &w;
+        timeouts = t;
+    }
+
+    //     .   (set_busy_poll() 
+    // ):     ,   recv() -- .
+    void watch(service_buffer& b) {
+        if (wheel)
+            b->m_obj->timer.attach(*wheel, timeouts);
+
+        b->m_obj->spin_usec = spin_usec;
+    }
+
+    size_t connections() {
+        return lockfree::atomic_add(&thread_count, 0);
+    }
+
+
+    //     (. handoff.h).
+
+    void hand_off_to(int channel) {
+        lockfree::cas(&handoff_fd, -1, channel);
+    }
+
+    bool handed_off() {
+        return (lockfree::atomic_add(&handoff_fd, 0) >= 0);
+    }
+
+    //   .     ,   shutdown().
+    void hand_off(int client) {
+
+        try {
+            send_fd(handoff_fd, client, 'C');
+
+        } catch (...) {
+            ::close(client);
+            throw;
+        }
+
+        ::close(client);
+    }
+
+    //  ,    accept() (,  ).
+    template <typename F>
+    void adopt(F f, int client, struct sockaddr_in peer, bool priority) {
+        boost::thread(boost::bind<void>(&server_socket::run<F>, this, f, client, peer, priority));
+    }
+
+    template <typename F>
+    void adopt(F f, int client, bool priority) {
+
+        struct sockaddr_in peer;
+        peer.sin_family = AF_UNSPEC;
+
+        adopt(f, client, peer, priority);
+    }
+
+
     //  .
 
     template <typename F>
@@ -316,11 +1002,8 @@ public:
 
             try {
 
-                int client = ::accept(fd, NULL, NULL);
-
-                if (client < 0) {
-                    throw error::system_error("could not accept() : ");
-                }
+                struct sockaddr_in peer;
+                int client = accept_client(peer);
 
                 if (maxconns > 0 &&
                     (size_t)lockfree::atomic_add(&thread_count, 0) >= maxconns) {
@@ -331,7 +1014,7 @@ public:
                 }
 
                 boost::thread(boost::bind<void>(&server_socket::run<F>, this,
-                                                boost::ref(f), client, priority));
+                                                boost::ref(f), client, peer, priority));
 
 
             } catch (std::exception& e) {
@@ -345,33 +1028,74 @@ public:
 };
 
 
-//  : ,    .
-typedef boost::shared_ptr<buffer<service_socket> > service_buffer;
 
+//  connect(),    deadline ( monotonic_usec(); 0 --  ).
+//  0  errno; ETIMEDOUT --  .   .
 
+inline int connect_until(int fd, const struct sockaddr_in& addr, unsigned long long deadline) {
 
-//  :  connect     .
+    int flags = ::fcntl(fd, F_GETFL, 0);
 
-class client_socket : public unknown_socket {
-public:
+    if (flags < 0 || ::fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0)
+        return errno;
 
-    void set_rcv_timeout(unsigned int rcv_timeout)
-    {
-        struct timeval tv;
-        tv.tv_sec = rcv_timeout / 1000;
-        tv.tv_usec = (rcv_timeout % 1000) * 1000;
+    int err = 0;
 
-        if (::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(struct timeval)) < 0)
-            logger::log(logger::ERROR) << "WARNING: setsockopt(SO_RCVTIMEO) failed. (" << rcv_timeout << ")";
-        //throw error::system_error("could not setsockopt(SO_RCVTIMEO) : ");
+    if (::connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+
+        err = errno;
+
+        while (err == EINPROGRESS || err == EINTR) {
+
+            int timeout = -1;
+
+            if (deadline > 0) {
+                unsigned long long now = monotonic_usec();
+
+                if (now >= deadline) {
+                    err = ETIMEDOUT;
+                    break;
+                }
+
+                timeout = (deadline - now + 999) / 1000;
+            }
+
+            struct pollfd pfd;
+            pfd.fd = fd;
+            pfd.events = POLLOUT;
+            pfd.revents = 0;
+
+            int tmp = ::poll(&pfd, 1, timeout);
+
+            if (tmp < 0 && errno != EINTR) {
+                err = errno;
+                break;
+            }
+
+            if (tmp > 0) {
+                socklen_t len = sizeof(err);
+
+                if (::getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0)
+                    err = errno;
+
+                break;
+            }
+        }
     }
 
-    client_socket(const std::string& host, int port,
-                  unsigned int rcv_timeout, unsigned int snd_timeout) : unknown_socket(-1) {
+    ::fcntl(fd, F_SETFL, flags);
+    return err;
+}
 
-        fd = ::socket(AF_INET, SOCK_STREAM, 0);
 
-        if (fd < 0) throw error::system_error("could not socket() : ");
+
+//  :  connect     .
+
+class client_socket : public unknown_socket {
+
+    bool fastopen;
+
+    void setopts_(unsigned int rcv_timeout, unsigned int snd_timeout) {
 
         int is_true = 1;
         if (::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &is_true, sizeof(is_true)) < 0)
@@ -405,6 +1129,38 @@ public:
 
             }
         }
+    }
+
+public:
+
+    void set_rcv_timeout(unsigned int rcv_timeout)
+    {
+        struct timeval tv;
+        tv.tv_sec = rcv_timeout / 1000;
+        tv.tv_usec = (rcv_timeout % 1000) * 1000;
+
+        if (::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(struct timeval)) < 0)
+            logger::log(logger::ERROR) << "WARNING: setsockopt(SO_RCVTIMEO) failed. (" << rcv_timeout << ")";
+        //throw error::system_error("could not setsockopt(SO_RCVTIMEO) : ");
+    }
+
+    // connect_timeout --  ; 0 -- ,    ().
+    //
+    // fastopen -- TCP Fast Open (TCP_FASTOPEN_CONNECT):      cookie,
+    // connect()  ,   send()    SYN.  cookie
+    // (   ) --  .     
+    //   send():  connect_timeout  ,    (,
+    // )    send()  recv().
+
+    client_socket(const std::string& host, int port,
+                  unsigned int rcv_timeout, unsigned int snd_timeout,
+                  unsigned int connect_timeout = 0, bool fastopen = false) : unknown_socket(-1), fastopen(false) {
+
+        fd = ::socket(AF_INET, SOCK_STREAM, 0);
+
+        if (fd < 0) throw error::system_error("could not socket() : ");
+
+        setopts_(rcv_timeout, snd_timeout);
 
         struct sockaddr_in addr;
         bzero(&addr, sizeof(addr));
@@ -414,9 +1170,45 @@ public:
         if (::inet_pton(AF_INET, host.c_str(), (void*)&addr.sin_addr) <= 0)
             teardown((files::fmt() << "could not inet_pton() (" << host << ") : ").data);
 
-        if (::connect(fd, (struct sockaddr*)&addr, sizeof(addr)))
-            teardown((files::fmt() << "could not connect() (" << host << ":" << port << ") : ").data);
+        int is_true = 1;
+        if (fastopen && ::setsockopt(fd, SOL_TCP, TCP_FASTOPEN_CONNECT, &is_true, sizeof(is_true)) == 0)
+            this->fastopen = true;
+
+        if (connect_timeout == 0) {
+
+            if (::connect(fd, (struct sockaddr*)&addr, sizeof(addr)))
+                teardown((files::fmt() << "could not connect() (" << host << ":" << port << ") : ").data);
+
+        } else {
+
+            errno = connect_until(fd, addr, monotonic_usec() + connect_timeout * 1000ULL);
+
+            if (errno != 0)
+                teardown((files::fmt() << "could not connect() (" << host << ":" << port << ") : ").data);
+        }
+    }
+
+    //    (. connect_race()).
+    client_socket(int connected, unsigned int rcv_timeout, unsigned int snd_timeout) : unknown_socket(connected), fastopen(false) {
+        setopts_(rcv_timeout, snd_timeout);
+    }
+
+    //     SYN,     --   .
+    ~client_socket() {
+
+        if (!fastopen || fd < 0)
+            return;
+
+        tcp_info inf;
+        socklen_t tmp = sizeof(inf);
+
+        if (::getsockopt(fd, IPPROTO_TCP, TCP_INFO, (void*)&inf, &tmp) < 0)
+            return;
 
+        if (inf.tcpi_options & TCPI_OPT_SYN_DATA)
+            stats::fastopen_connected().add();
+        else
+            stats::fastopen_fallback().add();
     }
 };
 
@@ -428,15 +1220,212 @@ typedef boost::shared_ptr<buffer<client_socket> > client_buffer;
 //    .
 
 inline client_buffer connect(const std::string& host, int port,
-                             unsigned int rcv_timeout = 0, unsigned int snd_timeout = 0)
+                             unsigned int rcv_timeout = 0, unsigned int snd_timeout = 0,
+                             unsigned int connect_timeout = 0, bool fastopen = false)
 try {
-    boost::shared_ptr<client_socket> s(new client_socket(host, port, rcv_timeout, snd_timeout));
+    boost::shared_ptr<client_socket> s(new client_socket(host, port, rcv_timeout, snd_timeout, connect_timeout, fastopen));
     return client_buffer(new buffer<client_socket>(s));
 } catch(const error::system_error &e) {
     throw connection_error( e.what() );
 }
 
 
+//  connect():   ,  ,   
+//   .  connect_finish() -- 0 (   )  errno.
+//      epoll (. httpd/fanout.h).
+
+inline client_buffer connect_nowait(const std::string& host, int port,
+                                    unsigned int rcv_timeout = 0, unsigned int snd_timeout = 0) {
+
+    struct sockaddr_in addr;
+    ::memset(&addr, 0, sizeof(addr));
+
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+
+    if (::inet_pton(AF_INET, host.c_str(), (void*)&addr.sin_addr) <= 0)
+        throw connection_error("could not inet_pton() (" + host + ")");
+
+    int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+    if (fd < 0)
+        throw error::system_error("could not socket() : ");
+
+    try {
+        boost::shared_ptr<client_socket> s(new client_socket(fd, rcv_timeout, snd_timeout));
+
+        if (::connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 && errno != EINPROGRESS) {
+            throw connection_error((files::fmt() << "could not connect() (" << host << ":" << port << ") : "
+                                                 << error::strerror()).data);
+        }
+
+        return client_buffer(new buffer<client_socket>(s));
+
+    } catch(const error::system_error &e) {
+        throw connection_error( e.what() );
+    }
+}
+
+inline int connect_finish(int fd) {
+
+    int err = 0;
+    socklen_t len = sizeof(err);
+
+    if (::getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0)
+        return errno;
+
+    if (err == 0 && ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL, 0) & ~O_NONBLOCK) < 0)
+        return errno;
+
+    return err;
+}
+
+
+//     addrs,    ( --   host  port,
+//  httpd::addresslist).     stagger , 
+//     (0 --  );  .   
+// ,       .
+// winner --     addrs.
+
+template <typename LIST>
+inline client_buffer connect_race(const LIST& addrs, unsigned int connect_timeout,
+                                  unsigned int rcv_timeout = 0, unsigned int snd_timeout = 0,
+                                  unsigned int stagger = 0, size_t* winner = NULL) {
+
+    unsigned long long start = monotonic_usec();
+    unsigned long long deadline = (connect_timeout > 0 ? start + connect_timeout * 1000ULL : 0);
+
+    std::vector<struct pollfd> pfds;
+    std::vector<size_t> index;
+
+    size_t next = 0;
+    unsigned long long next_at = start;
+    int err = ECONNREFUSED;
+
+    struct closer {
+        std::vector<struct pollfd>& pfds;
+
+        closer(std::vector<struct pollfd>& p) : pfds(p) {}
+
+        ~closer() {
+            for (size_t i = 0; i < pfds.size(); ++i)
+                if (pfds[i].fd >= 0) ::close(pfds[i].fd);
+        }
+    } c(pfds);
+
+    while (1) {
+
+        unsigned long long now = monotonic_usec();
+
+        //  :  ,  ,     .
+        size_t alive = 0;
+
+        for (size_t i = 0; i < pfds.size(); ++i)
+            if (pfds[i].fd >= 0) ++alive;
+
+        while (next < addrs.size() && (alive == 0 || stagger == 0 || now >= next_at)) {
+
+            struct sockaddr_in addr;
+            ::memset(&addr, 0, sizeof(addr));
+
+            addr.sin_family = AF_INET;
+            addr.sin_port = htons(addrs[next].port);
+
+            int fd = -1;
+
+            if (::inet_pton(AF_INET, addrs[next].host.c_str(), (void*)&addr.sin_addr) <= 0) {
+                err = EINVAL;
+
+            } else if ((fd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) < 0) {
+                err = errno;
+
+            } else if (::connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 && errno != EINPROGRESS) {
+                err = errno;
+                ::close(fd);
+                fd = -1;
+            }
+
+            ++next;
+
+            //  --    ,   stagger.
+            if (fd < 0)
+                continue;
+
+            struct pollfd p;
+            p.fd = fd;
+            p.events = POLLOUT;
+            p.revents = 0;
+
+            pfds.push_back(p);
+            index.push_back(next - 1);
+            ++alive;
+
+            next_at = now + stagger * 1000ULL;
+        }
+
+        if (alive == 0)
+            throw connection_error("connect_race() : all addresses failed : errno = " + files::format(err));
+
+        int timeout = -1;
+
+        if (next < addrs.size() && stagger > 0)
+            timeout = (next_at > now ? (next_at - now + 999) / 1000 : 0);
+
+        if (deadline > 0) {
+
+            if (now >= deadline)
+                throw connection_error("connect_race() : timeout");
+
+            int left = (deadline - now + 999) / 1000;
+
+            if (timeout < 0 || left < timeout)
+                timeout = left;
+        }
+
+        int tmp = ::poll(&pfds[0], pfds.size(), timeout);
+
+        if (tmp < 0 && errno != EINTR)
+            throw error::system_error("could not poll() : ");
+
+        for (size_t i = 0; tmp > 0 && i < pfds.size(); ++i) {
+
+            if (pfds[i].fd < 0 || pfds[i].revents == 0)
+                continue;
+
+            int e = 0;
+            socklen_t len = sizeof(e);
+
+            if (::getsockopt(pfds[i].fd, SOL_SOCKET, SO_ERROR, &e, &len) < 0)
+                e = errno;
+
+            if (e != 0) {
+                err = e;
+                ::close(pfds[i].fd);
+                pfds[i].fd = -1;
+                next_at = 0;
+                continue;
+            }
+
+            int fd = pfds[i].fd;
+            pfds[i].fd = -1;
+
+            ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL, 0) & ~O_NONBLOCK);
+
+            if (winner)
+                *winner = index[i];
+
+            try {
+                boost::shared_ptr<client_socket> s(new client_socket(fd, rcv_timeout, snd_timeout));
+                return client_buffer(new buffer<client_socket>(s));
+
+            } catch(const error::system_error &e) {
+                throw connection_error( e.what() );
+            }
+        }
+    }
+}
+
+
 
 template <typename C>
 inline std::pair<std::string,int> get_server_address(boost::shared_ptr<buffer<C> > sock) {
@@ -500,6 +1489,24 @@ inline void serve_blocking(server_socket& server, F service, size_t maxconns = 0
      c << ...;
      c >> ...;
 
+       200    :
+
+     c->m_obj->set_nonblocking(true);
+     c->m_obj->set_deadline(200);
+
+     try {
+        c << ...;
+        c >> ...;
+     } catch (deadline_exceeded& e) {
+        ...
+     }
+
+      TCP Fast Open (  --  SYN):
+
+     server.set_fastopen(256);
+
+     client_buffer c = connect("192.168.0.2", 11099, 1000, 1000, 0, true);
+
 
  */
 
@@ -2,9 +2,17 @@
 #define __CLIENTSERVER_CLIENTSERVER_BASE_H
 
 
+#include <string.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <sys/syscall.h>
+
+#include <string>
 #include <vector>
+#include <utility>
 
 #include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
 
 
 namespace clientserver {
@@ -18,6 +26,155 @@ class eof_exception : public std::exception {
 };
 
 
+// -    send()/recv(),   io_uring (. uring.h).
+//       backend,     .
+
+class io_backend {
+public:
+    virtual void send(const void* data, size_t len) = 0;
+    virtual void sendv(struct iovec* iov, size_t n, bool more) = 0;
+    virtual size_t recv(void* buff, size_t len) = 0;
+    virtual size_t recv_nowait(void* buff, size_t len) = 0;
+
+    virtual ~io_backend() {}
+};
+
+
+
+/*
+ *    :    4  64,  .
+ *   ;     ,   
+ * MAX_CACHED    --   .
+ *
+ *     NUMA-:      ,  
+ *  ,   ,   .  , 
+ *   ,    (. affinity.h),     .
+ */
+
+class buffer_pool {
+
+public:
+
+    static const size_t MIN_SIZE = 4*1024;
+    static const size_t CLASSES = 5;
+    static const size_t MAX_CACHED = 16*1024*1024;
+
+private:
+
+    struct size_class {
+        boost::mutex lock;
+        std::vector<unsigned char*> free;
+        long in_use;
+        unsigned long created;
+
+        size_class() : in_use(0), created(0) {}
+    };
+
+    size_class m_classes[CLASSES];
+
+    static size_t class_of(size_t size) {
+        size_t c = 0;
+
+        while (c < CLASSES && (MIN_SIZE << c) < size) ++c;
+
+        return c;
+    }
+
+public:
+
+    static const unsigned int MAX_NODES = 64;
+
+    //   :      
+    //           .
+    static buffer_pool& pool(unsigned int node) {
+        static buffer_pool* ret = new buffer_pool[MAX_NODES];
+        return ret[node % MAX_NODES];
+    }
+
+    //   NUMA-.
+    static buffer_pool& pool() {
+        unsigned int cpu = 0;
+        unsigned int node = 0;
+
+        if (::syscall(SYS_getcpu, &cpu, &node, NULL) < 0)
+            node = 0;
+
+        return pool(node);
+    }
+
+    //  size    .
+    unsigned char* acquire(size_t& size) {
+
+        size_t c = class_of(size);
+
+        if (c == CLASSES)
+            return new unsigned char[size];
+
+        size = MIN_SIZE << c;
+
+        size_class& sc = m_classes[c];
+        boost::mutex::scoped_lock l(sc.lock);
+
+        ++sc.in_use;
+
+        if (!sc.free.empty()) {
+            unsigned char* ret = sc.free.back();
+            sc.free.pop_back();
+            return ret;
+        }
+
+        ++sc.created;
+        l.unlock();
+
+        return new unsigned char[size];
+    }
+
+    void release(unsigned char* p, size_t size) {
+
+        size_t c = class_of(size);
+
+        if (c == CLASSES) {
+            delete [] p;
+            return;
+        }
+
+        size_class& sc = m_classes[c];
+        boost::mutex::scoped_lock l(sc.lock);
+
+        --sc.in_use;
+
+        if (sc.free.size() * size < MAX_CACHED) {
+            sc.free.push_back(p);
+            return;
+        }
+
+        l.unlock();
+        delete [] p;
+    }
+
+    //    c: , ,   ,  .
+
+    static size_t class_size(size_t c) {
+        return MIN_SIZE << c;
+    }
+
+    long in_use(size_t c) {
+        boost::mutex::scoped_lock l(m_classes[c].lock);
+        return m_classes[c].in_use;
+    }
+
+    size_t cached(size_t c) {
+        boost::mutex::scoped_lock l(m_classes[c].lock);
+        return m_classes[c].free.size();
+    }
+
+    unsigned long created(size_t c) {
+        boost::mutex::scoped_lock l(m_classes[c].lock);
+        return m_classes[c].created;
+    }
+};
+
+
 
 //  .
 template <typename T>
@@ -29,27 +186,183 @@ public:
     size_t scanned;
 
 private:
-    std::vector<unsigned char> m_buff;
-    std::vector<unsigned char>::const_iterator m_cur;
-    std::vector<unsigned char>::const_iterator m_end;
+    //    buffer_pool   :  INITIAL_SIZE,
+    //   --  ,  BUFF_SIZE.   ,
+    //      (release()).
+    unsigned char* m_buff;
+    size_t m_size;
+    const unsigned char* m_cur;
+    const unsigned char* m_end;
+
+    //   m_buff.
+    buffer_pool* m_pool;
+
+    // ,     (. mark()); NULL --  .
+    const unsigned char* m_mark;
+    size_t m_mark_scanned;
+
+    //   (. cork()).
+    std::vector<std::string> m_out;
+    size_t m_out_size;
+    bool m_corked;
+
+    //    (. defer_writes()):     m_out.front().
+    bool m_deferred;
+    size_t m_out_off;
+
+    //     , .
+    size_t m_written;
+
+    //    ,   . false --  :
+    //    ,     .
+    bool room_for_mark_() {
+
+        if (m_end != m_buff + m_size)
+            return true;
+
+        if (m_mark != m_buff) {
+            size_t n = m_end - m_mark;
+            size_t cur = m_cur - m_mark;
+            ::memmove(m_buff, m_mark, n);
+            m_mark = m_buff;
+            m_cur = m_buff + cur;
+            m_end = m_buff + n;
+            return true;
+        }
+
+        if (m_size < BUFF_SIZE) {
+            reserve(m_size * 2);
+            return true;
+        }
+
+        return false;
+    }
 
     //      .
     void fill() {
-	size_t s = m_obj->recv(&(m_buff[0]), m_buff.size());
 
-	m_cur = m_buff.begin();
+        //     .
+        if (m_out_size > 0 && !m_deferred)
+            write_queued(false);
+
+        //   ,   .   --  .
+        if (m_mark != NULL && !room_for_mark_())
+            m_mark = NULL;
+
+        if (m_mark != NULL) {
+            size_t off = m_end - m_buff;
+            size_t s = m_obj->recv(m_buff + off, m_size - off);
+
+            m_cur = m_buff + off;
+            m_end = m_cur + s;
+            return;
+        }
+
+        //      --   , .
+        if (m_buff == NULL)
+            reserve(INITIAL_SIZE);
+        else if (m_end == m_buff + m_size && m_size < BUFF_SIZE)
+            reserve(m_size * 2);
+
+	size_t s = m_obj->recv(m_buff, m_size);
+
+	m_cur = m_buff;
 	m_end = m_cur + s;
     }
 
+    //   ( )      size.
+    void reserve(size_t size) {
+
+        const unsigned char* from = (m_mark != NULL ? m_mark : m_cur);
+        size_t n = m_end - from;
+        size_t cur = m_cur - from;
+        buffer_pool& p = buffer_pool::pool();
+        unsigned char* b = p.acquire(size);
+
+        if (n > 0)
+            ::memcpy(b, from, n);
+
+        if (m_buff != NULL)
+            m_pool->release(m_buff, m_size);
+
+        m_pool = &p;
+        m_buff = b;
+        m_size = size;
+
+        if (m_mark != NULL)
+            m_mark = b;
+
+        m_cur = b + cur;
+        m_end = b + n;
+    }
+
+    buffer(const buffer&);
+    buffer& operator=(const buffer&);
+
+    //   --  sendmsg()   IOV_CHUNK . ( sendv()  T.)
+    // more:   ,       (MSG_MORE).
+    void write_queued(bool more) {
+
+        static const size_t IOV_CHUNK = 64;
+        struct iovec iov[IOV_CHUNK];
+
+        size_t i = 0;
+
+        while (i < m_out.size()) {
+
+            size_t n = 0;
+
+            for (; n < IOV_CHUNK && i < m_out.size(); ++n, ++i) {
+                iov[n].iov_base = (void*)m_out[i].data();
+                iov[n].iov_len = m_out[i].size();
+            }
+
+            m_obj->sendv(iov, n, more || i < m_out.size());
+        }
+
+        m_out.clear();
+        m_out_size = 0;
+    }
+
+    void queue(const char* data, size_t len) {
+
+        //  ,    iovec'.
+        if (!m_out.empty() && m_out.back().size() < SMALL_WRITE && len < SMALL_WRITE) {
+            m_out.back().append(data, len);
+
+        } else {
+            m_out.push_back(std::string(data, len));
+        }
+
+        m_out_size += len;
+
+        if (m_out_size >= BUFF_SIZE && !m_deferred)
+            write_queued(true);
+    }
+
 public:
 
-    //    64.
+    //     64.
     static const size_t BUFF_SIZE = 64*1024;
+    static const size_t INITIAL_SIZE = 4*1024;
+
+    //        ,  --  iovec.
+    static const size_t SMALL_WRITE = 4*1024;
+
+    buffer(boost::shared_ptr<T> o) : m_obj(o), scanned(0), m_buff(NULL), m_size(0), m_cur(NULL), m_end(NULL),
+                                     m_pool(NULL), m_mark(NULL), m_mark_scanned(0), m_out_size(0), m_corked(false),
+                                     m_deferred(false), m_out_off(0), m_written(0) {}
+
+    ~buffer() {
+        try {
+            if (m_out_size > 0 && !m_deferred)
+                write_queued(false);
 
-    buffer(boost::shared_ptr<T> o) : m_obj(o), scanned(0) {
-	m_buff.resize(BUFF_SIZE);
-	m_end = m_buff.end();
-	m_cur = m_end;
+        //   :  .
+        } catch (...) { }
+
+        if (m_buff != NULL)
+            m_pool->release(m_buff, m_size);
     }
 
     //     .
@@ -95,7 +408,7 @@ public:
 	    }
 
 	    if (e-i <= m_end-m_cur) {
-		std::vector<unsigned char>::const_iterator tmpe = m_cur + (e-i);
+		const unsigned char* tmpe = m_cur + (e-i);
 
 		std::copy(m_cur, tmpe, i);
 		m_cur = tmpe;
@@ -109,20 +422,275 @@ public:
 	}
     }
 
-    //      !!
-    //        .
+    //       ,  send()   .
+    //  cork()      sendmsg()  send_pending().
     buffer& operator<<(const std::string& s) {
-        if (!s.empty ())
+        if (s.empty ())
+            return *this;
+
+        m_written += s.size();
+
+        if (m_corked || m_deferred)
+            queue(s.data(), s.size());
+        else
             m_obj->send(s.data(), s.size());
+
 	return *this;
     }
 
     buffer& operator<<(const std::vector<unsigned char>& s) {
-        if (!s.empty())
+        if (s.empty())
+            return *this;
+
+        m_written += s.size();
+
+        if (m_corked || m_deferred)
+            queue((const char*)&(s[0]), s.size());
+        else
             m_obj->send(&(s[0]), s.size());
+
+        return *this;
+    }
+
+    //  operator<<,   :  s , s  .
+    buffer& take(std::string& s) {
+        if (s.empty())
+            return *this;
+
+        m_written += s.size();
+
+        if (!m_corked && !m_deferred) {
+            m_obj->send(s.data(), s.size());
+            s.clear();
+            return *this;
+        }
+
+        m_out_size += s.size();
+        m_out.push_back(std::string());
+        m_out.back().swap(s);
+
+        if (m_out_size >= BUFF_SIZE && !m_deferred)
+            write_queued(true);
+
         return *this;
     }
 
+    void cork() {
+        m_corked = true;
+    }
+
+    //        .
+    // more:      (. zerocopy.h),    .
+    void send_pending(bool more = false) {
+        if (m_out_size > 0 && !m_deferred)
+            write_queued(more);
+
+        m_corked = false;
+    }
+
+    size_t pending() const {
+        return m_out_size;
+    }
+
+    size_t bytes_written() const {
+        return m_written;
+    }
+
+    //    (. evented.h):  ,   cork(),  send_pending()
+    //    --     send_some().
+    void defer_writes() {
+        m_deferred = true;
+    }
+
+    bool deferred() const {
+        return m_deferred;
+    }
+
+    //   ,    . , 
+    // . ( sendv_nowait()  T.)
+    size_t send_some() {
+
+        static const size_t IOV_CHUNK = 64;
+        struct iovec iov[IOV_CHUNK];
+
+        while (m_out_size > 0) {
+
+            size_t n = 0;
+
+            for (; n < IOV_CHUNK && n < m_out.size(); ++n) {
+                iov[n].iov_base = (void*)m_out[n].data();
+                iov[n].iov_len = m_out[n].size();
+            }
+
+            iov[0].iov_base = (char*)iov[0].iov_base + m_out_off;
+            iov[0].iov_len -= m_out_off;
+
+            size_t sent = m_obj->sendv_nowait(iov, n, n < m_out.size());
+
+            if (sent == 0)
+                break;
+
+            m_out_size -= sent;
+            sent += m_out_off;
+
+            size_t done = 0;
+
+            while (done < m_out.size() && sent >= m_out[done].size()) {
+                sent -= m_out[done].size();
+                ++done;
+            }
+
+            m_out.erase(m_out.begin(), m_out.begin() + done);
+            m_out_off = sent;
+        }
+
+        return m_out_size;
+    }
+
+    //  ,     ,  .
+    //    . ( recv_nowait()  T.)
+    size_t fill_available() {
+
+        if (m_buff == NULL) {
+            reserve(INITIAL_SIZE);
+
+        } else if (m_mark != NULL) {
+            room_for_mark_();
+
+        } else if (m_cur == m_end) {
+            m_cur = m_buff;
+            m_end = m_cur;
+
+        } else if (m_end == m_buff + m_size) {
+
+            //   :  ,  .
+            if (m_cur != m_buff) {
+                size_t n = m_end - m_cur;
+                ::memmove(m_buff, m_cur, n);
+                m_cur = m_buff;
+                m_end = m_cur + n;
+
+            } else if (m_size < BUFF_SIZE) {
+                reserve(m_size * 2);
+            }
+        }
+
+        size_t off = m_end - m_buff;
+
+        if (off == m_size)
+            return 0;
+
+        size_t s = m_obj->recv_nowait(m_buff + off, m_size - off);
+        m_end = m_buff + off + s;
+        return s;
+    }
+
+    //    ,   . (, keep-alive   .)
+    void release() {
+
+        if (m_buff == NULL || m_cur != m_end || m_mark != NULL)
+            return;
+
+        m_pool->release(m_buff, m_size);
+
+        m_pool = NULL;
+        m_buff = NULL;
+        m_size = 0;
+        m_cur = NULL;
+        m_end = NULL;
+    }
+
+    //  ,        (rewind()).  unmark()
+    //     ,      BUFF_SIZE:
+    //   --  .
+    void mark() {
+
+        if (m_buff == NULL)
+            reserve(INITIAL_SIZE);
+
+        m_mark = m_cur;
+        m_mark_scanned = scanned;
+    }
+
+    //      . false --  .
+    bool rewind() {
+
+        if (m_mark == NULL)
+            return false;
+
+        m_cur = m_mark;
+        scanned = m_mark_scanned;
+        m_mark = NULL;
+        return true;
+    }
+
+    void unmark() {
+        m_mark = NULL;
+    }
+
+    //    ,     .
+    std::pair<const unsigned char*, size_t> peek() const {
+        return std::make_pair(m_cur, (size_t)(m_end - m_cur));
+    }
+
+    size_t available() const {
+        return m_end - m_cur;
+    }
+
+    //  n     (n <= available()).
+    void consume(size_t n) {
+        m_cur += n;
+        scanned += n;
+    }
+
+    //  ,    .
+
+    //   out   delim . ,  .
+    size_t read_until(unsigned char delim, std::string& out) {
+
+        size_t n = 0;
+
+        while (1) {
+
+            if (m_cur == m_end) {
+                fill();
+            }
+
+            const unsigned char* b = m_cur;
+            const unsigned char* e = (const unsigned char*)::memchr(b, delim, m_end - m_cur);
+
+            size_t len = (e == NULL ? m_end - m_cur : (e - b) + 1);
+
+            out.append((const char*)b, len);
+            consume(len);
+            n += len;
+
+            if (e != NULL)
+                return n;
+        }
+    }
+
+    //   max   ,  ;    -- .     .
+    std::pair<const unsigned char*, size_t> read_some(size_t max) {
+
+        if (m_cur == m_end) {
+            fill();
+        }
+
+        std::pair<const unsigned char*, size_t> ret = peek();
+
+        if (ret.second > max)
+            ret.second = max;
+
+        consume(ret.second);
+        return ret;
+    }
+
+    //       .
+    bool full() const {
+        return m_size >= BUFF_SIZE && m_cur == m_buff && m_end == m_buff + m_size;
+    }
+
     // ,   . (,  lseek.)
     void flush() {
         m_cur = m_end;
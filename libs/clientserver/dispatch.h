@@ -0,0 +1,241 @@
+#ifndef __CLIENTSERVER_DISPATCH_H
+#define __CLIENTSERVER_DISPATCH_H
+
+
+#include <vector>
+#include <algorithm>
+
+#include <boost/bind.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "clientserver.h"
+#include "unix_server.h"
+#include "unix_client.h"
+
+
+namespace clientserver {
+
+
+/*
+ *    .
+ *
+ *        (SCM_RIGHTS) 
+ *   ;      , 
+ *    .     
+ *  unix- SOCK_SEQPACKET:   --  .
+ */
+
+
+// .
+
+class dispatcher {
+
+    //    . ,     :
+    // send_fd()   ,        .
+    struct worker {
+        int fd;
+
+        worker(int f) : fd(f) {}
+
+        ~worker() {
+            ::close(fd);
+        }
+    };
+
+    typedef boost::shared_ptr<worker> worker_ptr;
+
+    unix_server_socket channel;
+
+    std::vector<worker_ptr> workers;
+    size_t next;
+
+    unsigned long dispatched;
+    boost::mutex m_lock;
+
+    void accept_workers() {
+
+        while (1) {
+
+            try {
+
+                struct sockaddr_in peer;
+                worker_ptr w(new worker(channel.accept_client(peer)));
+
+                boost::mutex::scoped_lock l(m_lock);
+                workers.push_back(w);
+
+            } catch (std::exception& e) {
+                logger::log(logger::ERROR) << "ERROR in dispatch : " << e.what();
+
+            } catch (...) {
+                logger::log(logger::ERROR) << "UNKNOWN ERROR in dispatch";
+            }
+        }
+    }
+
+public:
+
+    dispatcher(const std::string& path) : channel(path, 0, 0, SOCK_SEQPACKET), next(0), dispatched(0) {
+        boost::thread th(boost::bind(&dispatcher::accept_workers, this));
+    }
+
+    //      .   client
+    //    (close(),  shutdown()!)   .
+    // false --   .
+
+    bool dispatch(int client) {
+
+        while (1) {
+
+            worker_ptr w;
+
+            //    ; send_fd()  ,     .
+            {
+                boost::mutex::scoped_lock l(m_lock);
+
+                if (workers.empty())
+                    return false;
+
+                w = workers[next++ % workers.size()];
+            }
+
+            try {
+                send_fd(w->fd, client, 'C');
+
+                boost::mutex::scoped_lock l(m_lock);
+                ++dispatched;
+                return true;
+
+            } catch (std::exception& e) {
+                logger::log(logger::ERROR) << "WARNING: dropping worker : " << e.what();
+
+                boost::mutex::scoped_lock l(m_lock);
+                std::vector<worker_ptr>::iterator i = std::find(workers.begin(), workers.end(), w);
+
+                if (i != workers.end())
+                    workers.erase(i);
+            }
+        }
+    }
+
+    size_t worker_count() {
+        boost::mutex::scoped_lock l(m_lock);
+        return workers.size();
+    }
+
+    unsigned long dispatched_count() {
+        boost::mutex::scoped_lock l(m_lock);
+        return dispatched;
+    }
+};
+
+
+inline void serve_dispatching_blocking(server_socket& server, dispatcher& d) {
+
+    while (1) {
+
+        try {
+
+            struct sockaddr_in peer;
+            int client = server.accept_client(peer);
+
+            if (!d.dispatch(client)) {
+                logger::log(logger::ERROR) << "WARNING: no workers, connection dropped";
+                ::shutdown(client, SHUT_RDWR);
+            }
+
+            ::close(client);
+
+        } catch (std::exception& e) {
+            logger::log(logger::ERROR) << "ERROR in serving : " << e.what();
+
+        } catch (...) {
+            logger::log(logger::ERROR) << "UNKNOWN ERROR in serving";
+        }
+    }
+}
+
+inline void serve_dispatching(server_socket& server, dispatcher& d) {
+    boost::thread th(boost::bind(&serve_dispatching_blocking, boost::ref(server), boost::ref(d)));
+}
+
+
+
+//  .    :    .
+//    (set_timeouts) --    server_socket.
+
+class dispatched_server_socket : public server_socket {
+public:
+
+    dispatched_server_socket(unsigned int rtimeout = 0, unsigned int stimeout = 0) :
+        server_socket(rtimeout, stimeout, (rtimeout > 0 || stimeout > 0)) {}
+};
+
+
+// ,    .
+
+template <typename F>
+inline void serve_dispatched_blocking(server_socket& server, const std::string& path, F service, bool priority = false) {
+
+    unix_client_socket channel(path, 0, 0, SOCK_SEQPACKET);
+
+    while (1) {
+
+        try {
+
+            char tag;
+            int client = recv_fd(channel.fd, tag);
+
+            if (client < 0)
+                continue;
+
+            if (tag != 'C') {
+                ::close(client);
+                continue;
+            }
+
+            server.adopt(service, client, priority);
+
+        } catch (eof_exception& e) {
+            return;
+
+        } catch (std::exception& e) {
+            logger::log(logger::ERROR) << "ERROR in dispatch : " << e.what();
+            return;
+
+        } catch (...) {
+            logger::log(logger::ERROR) << "UNKNOWN ERROR in dispatch";
+            return;
+        }
+    }
+}
+
+template <typename F>
+inline void serve_dispatched(server_socket& server, const std::string& path, F service, bool priority = false) {
+    boost::thread th(boost::bind<void>(&serve_dispatched_blocking<F>, boost::ref(server), path, service, priority));
+}
+
+}
+
+/*
+
+    :
+
+     // .
+     server_socket server("0.0.0.0", 9876);
+     dispatcher d("/var/run/app.workers");
+
+     serve_dispatching(server, d);
+
+     //   (    ).
+     dispatched_server_socket server;
+     server.set_timeouts(wheel, connection_timeouts(30000, 5000, 10000));
+
+     serve_dispatched_blocking(server, "/var/run/app.workers", service);
+
+ */
+
+
+#endif
@@ -0,0 +1,358 @@
+#ifndef __CLIENTSERVER_EVENTED_H
+#define __CLIENTSERVER_EVENTED_H
+
+
+#include <sys/epoll.h>
+
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+#include "clientserver.h"
+
+
+namespace clientserver {
+
+
+/*
+ *   .
+ *
+ *       --    epoll.
+ *    ,      
+ *   (,  http-) --   .
+ *
+ *     service_buffer,     serve(), 
+ *       bool:    .
+ *     epoll,       .
+ *
+ *     . ,    ,  deadline_exceeded:
+ *   (buffer::mark())     ,  
+ * .  ,         
+ *   (BUFF_SIZE) --   .    
+ * (buffer::defer_writes())     ;    , 
+ *      .
+ */
+
+
+//   :    --     (  http).
+struct head_complete {
+
+    template <typename B>
+    bool operator()(const B& b) const {
+
+        std::pair<const unsigned char*, size_t> s = b.peek();
+
+        const unsigned char* i = s.first;
+        const unsigned char* e = s.first + s.second;
+
+        while (i != e) {
+
+            i = (const unsigned char*)::memchr(i, '\n', e - i);
+
+            if (i == NULL) return false;
+
+            ++i;
+
+            if (i != e && *i == '\r') ++i;
+            if (i != e && *i == '\n') return true;
+        }
+
+        return false;
+    }
+};
+
+//  - :    .
+struct any_input {
+    template <typename B>
+    bool operator()(const B& b) const {
+        return b.available() > 0;
+    }
+};
+
+
+template <typename F, typename P>
+class evented_server {
+
+    struct connection {
+        service_buffer buf;
+
+        //   : ,    .
+        bool closing;
+
+        connection(int fd, unsigned int n, const struct sockaddr_in& peer) :
+            buf(make_connection(fd, n, peer)), closing(false) {}
+    };
+
+    enum served_t { SERVED, SHORT_READ, CLOSE };
+
+    server_socket& server;
+    F service;
+    P complete;
+
+    std::vector<int> loops;
+    size_t next_loop;
+
+    int conn_count;
+    size_t maxconns;
+
+    void arm(int epfd, connection* c, int op) {
+
+        struct epoll_event ev;
+        ev.events = (c->buf->pending() > 0 ? EPOLLOUT : EPOLLIN) | EPOLLRDHUP | EPOLLONESHOT;
+        ev.data.ptr = c;
+
+        if (::epoll_ctl(epfd, op, c->buf->m_obj->fd, &ev) < 0)
+            throw error::system_error("could not epoll_ctl() : ");
+    }
+
+    void close(connection* c) {
+        delete c;
+        lockfree::atomic_add(&conn_count, -1);
+    }
+
+    //  .  ,  .
+    served_t serve_one(connection* c) {
+
+        buffer<service_socket>& b = *(c->buf);
+        size_t written = b.bytes_written();
+
+        b.mark();
+
+        try {
+            bool keep = service(c->buf);
+
+            b.unmark();
+            return (keep ? SERVED : CLOSE);
+
+        } catch (deadline_exceeded& e) {
+
+            if (b.bytes_written() == written && b.rewind())
+                return SHORT_READ;
+
+            logger::log(logger::ERROR) << "WARNING: could not replay a short read in evented handler, closing";
+            return CLOSE;
+        }
+    }
+
+    //  false,    .
+    bool handle(connection* c) {
+
+        buffer<service_socket>& b = *(c->buf);
+
+        //  -- ;    ,    .
+        if (b.send_some() > 0)
+            return true;
+
+        if (c->closing)
+            return false;
+
+        b.fill_available();
+
+        while (complete(b) || b.full()) {
+
+            size_t scanned = b.bytes_scanned();
+            size_t avail = b.available();
+
+            served_t r = serve_one(c);
+
+            if (r == SHORT_READ)
+                break;
+
+            if (r == CLOSE) {
+                c->closing = true;
+                return (b.send_some() > 0);
+            }
+
+            if (b.send_some() > 0 || b.available() == 0)
+                break;
+
+            //    :     . 
+            //      --   .
+            if (b.bytes_scanned() == scanned && b.available() == avail) {
+
+                if (b.full()) {
+                    logger::log(logger::ERROR) << "WARNING: handler consumed nothing from a full buffer, closing";
+                    return false;
+                }
+
+                break;
+            }
+        }
+
+        //   --   ,  --  .
+        if (b.available() > 0)
+            b.m_obj->timer.reading();
+        else
+            b.m_obj->timer.idle();
+
+        //      .
+        b.release();
+        return true;
+    }
+
+    void loop(int epfd) {
+
+        static const int MAX_EVENTS = 256;
+        struct epoll_event events[MAX_EVENTS];
+
+        while (1) {
+
+            int n = ::epoll_wait(epfd, events, MAX_EVENTS, -1);
+
+            if (n < 0) {
+                if (errno != EINTR)
+                    logger::log(logger::ERROR) << "ERROR in epoll_wait() : " << error::strerror();
+                continue;
+            }
+
+            for (int i = 0; i < n; ++i) {
+
+                connection* c = (connection*)events[i].data.ptr;
+                bool keep = false;
+
+                try {
+                    keep = handle(c);
+
+                    if (keep)
+                        arm(epfd, c, EPOLL_CTL_MOD);
+
+                } catch (eof_exception& e) {
+                    keep = false;
+
+                } catch (std::exception& e) {
+                    logger::log(logger::ERROR) << "ERROR in evented serving : " << e.what();
+                    keep = false;
+
+                } catch (...) {
+                    logger::log(logger::ERROR) << "UNKNOWN ERROR in evented serving";
+                    keep = false;
+                }
+
+                if (!keep)
+                    close(c);
+            }
+        }
+    }
+
+public:
+
+    evented_server(server_socket& s, F f, P p, unsigned int nloops, size_t maxc) :
+        server(s), service(f), complete(p), next_loop(0), conn_count(0), maxconns(maxc) {
+
+        if (nloops == 0) nloops = 1;
+
+        for (unsigned int i = 0; i < nloops; ++i) {
+            int epfd = ::epoll_create1(EPOLL_CLOEXEC);
+
+            if (epfd < 0)
+                throw error::system_error("could not epoll_create1() : ");
+
+            loops.push_back(epfd);
+        }
+    }
+
+    size_t connections() {
+        return lockfree::atomic_add(&conn_count, 0);
+    }
+
+    void serve() {
+
+        for (size_t i = 0; i < loops.size(); ++i) {
+            boost::thread(boost::bind(&evented_server::loop, this, loops[i]));
+        }
+
+        while (1) {
+
+            try {
+
+                struct sockaddr_in peer;
+                int client = server.accept_client(peer);
+
+                if (maxconns > 0 &&
+                    (size_t)lockfree::atomic_add(&conn_count, 0) >= maxconns) {
+
+                    ::shutdown(client, SHUT_RDWR);
+                    ::close(client);
+                    continue;
+                }
+
+                server.setup_client(client);
+
+                int n = lockfree::atomic_add(&conn_count, 1);
+                connection* c = new connection(client, n, peer);
+                server.watch(c->buf);
+
+                try {
+                    //   : ,    ,   deadline_exceeded.
+                    c->buf->m_obj->set_nonblocking(true);
+                    c->buf->m_obj->deadline = 1;
+                    c->buf->defer_writes();
+
+                    arm(loops[next_loop++ % loops.size()], c, EPOLL_CTL_ADD);
+
+                } catch (...) {
+                    close(c);
+                    throw;
+                }
+
+            } catch (std::exception& e) {
+                logger::log(logger::ERROR) << "ERROR in serving : " << e.what();
+
+            } catch (...) {
+                logger::log(logger::ERROR) << "UNKNOWN ERROR in serving";
+            }
+        }
+    }
+};
+
+
+template <typename F, typename P>
+inline void serve_evented_blocking(server_socket& server, F service, unsigned int nloops, size_t maxconns, P complete) {
+
+    evented_server<F,P> es(server, service, complete, nloops, maxconns);
+    es.serve();
+}
+
+template <typename F>
+inline void serve_evented_blocking(server_socket& server, F service, unsigned int nloops = 1, size_t maxconns = 0) {
+    serve_evented_blocking(server, service, nloops, maxconns, head_complete());
+}
+
+template <typename F, typename P>
+inline void serve_evented(server_socket& server, F service, unsigned int nloops, size_t maxconns, P complete) {
+
+    boost::thread th(boost::bind<void>(&serve_evented_blocking<F,P>,
+                                       boost::ref(server), service, nloops, maxconns, complete));
+}
+
+template <typename F>
+inline void serve_evented(server_socket& server, F service, unsigned int nloops = 1, size_t maxconns = 0) {
+    serve_evented(server, service, nloops, maxconns, head_complete());
+}
+
+}
+
+/*
+
+    :
+
+     bool service(service_buffer sock) {
+
+        httpd::request req;
+        httpd::parse_request(sock, req);
+
+        httpd::responder resp(sock, req);
+        ...
+        resp.send();
+
+        return !resp.should_close;
+     }
+
+     server_socket server("0.0.0.0", 9876);
+     serve_evented(server, service, 4, 10000, httpd::request_head_complete());
+
+ */
+
+
+#endif
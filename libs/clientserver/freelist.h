@@ -0,0 +1,193 @@
+#ifndef __CLIENTSERVER_FREELIST_H
+#define __CLIENTSERVER_FREELIST_H
+
+
+#include <stddef.h>
+
+#include <new>
+#include <vector>
+
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/tss.hpp>
+
+
+namespace clientserver {
+
+
+/*
+ *     .
+ *
+ *     ,  .  ( 
+ *  )      ,  
+ *      --      ,
+ *    (,  epoll,  accept   ).
+ */
+
+template <size_t SIZE>
+class freelist {
+
+    static const size_t LOCAL_MAX = 64;
+    static const size_t BATCH = LOCAL_MAX / 2;
+    static const size_t DEPOT_MAX = 4096;
+
+    struct local {
+        std::vector<void*> blocks;
+    };
+
+    struct depot {
+        boost::mutex lock;
+        std::vector<void*> blocks;
+    };
+
+    //   :       
+    //      (  buffer_pool).
+    static depot& get_depot() {
+        static depot* ret = new depot;
+        return *ret;
+    }
+
+    //  n   ;  -- .
+    static void to_depot(std::vector<void*>& v, size_t n) {
+
+        depot& d = get_depot();
+        boost::mutex::scoped_lock l(d.lock);
+
+        while (n > 0 && !v.empty()) {
+
+            if (d.blocks.size() < DEPOT_MAX)
+                d.blocks.push_back(v.back());
+            else
+                ::operator delete(v.back());
+
+            v.pop_back();
+            --n;
+        }
+    }
+
+    static void from_depot(std::vector<void*>& v) {
+
+        depot& d = get_depot();
+        boost::mutex::scoped_lock l(d.lock);
+
+        for (size_t i = 0; i < BATCH && !d.blocks.empty(); ++i) {
+            v.push_back(d.blocks.back());
+            d.blocks.pop_back();
+        }
+    }
+
+    static void cleanup(local* l) {
+        to_depot(l->blocks, l->blocks.size());
+        delete l;
+    }
+
+    static local& get_local() {
+        static boost::thread_specific_ptr<local> ptr(&freelist::cleanup);
+
+        local* ret = ptr.get();
+
+        if (ret == NULL) {
+            ret = new local;
+            ret->blocks.reserve(LOCAL_MAX);
+            ptr.reset(ret);
+        }
+
+        return *ret;
+    }
+
+public:
+
+    static void* allocate() {
+
+        local& l = get_local();
+
+        if (l.blocks.empty())
+            from_depot(l.blocks);
+
+        if (l.blocks.empty())
+            return ::operator new(SIZE);
+
+        void* ret = l.blocks.back();
+        l.blocks.pop_back();
+        return ret;
+    }
+
+    static void deallocate(void* p) {
+
+        local& l = get_local();
+
+        if (l.blocks.size() >= LOCAL_MAX)
+            to_depot(l.blocks, BATCH);
+
+        l.blocks.push_back(p);
+    }
+};
+
+
+//   freelist:  boost::allocate_shared     .
+
+template <typename T>
+struct freelist_allocator {
+
+    typedef T value_type;
+    typedef T* pointer;
+    typedef const T* const_pointer;
+    typedef T& reference;
+    typedef const T& const_reference;
+    typedef size_t size_type;
+    typedef ptrdiff_t difference_type;
+
+    template <typename U>
+    struct rebind {
+        typedef freelist_allocator<U> other;
+    };
+
+    freelist_allocator() {}
+
+    template <typename U>
+    freelist_allocator(const freelist_allocator<U>&) {}
+
+    T* allocate(size_t n, const void* = 0) {
+
+        if (n != 1)
+            return (T*)::operator new(n * sizeof(T));
+
+        return (T*)freelist<sizeof(T)>::allocate();
+    }
+
+    void deallocate(T* p, size_t n) {
+
+        if (n != 1) {
+            ::operator delete(p);
+            return;
+        }
+
+        freelist<sizeof(T)>::deallocate(p);
+    }
+
+    size_t max_size() const {
+        return ((size_t)-1) / sizeof(T);
+    }
+
+    void construct(T* p, const T& t) {
+        new ((void*)p) T(t);
+    }
+
+    void destroy(T* p) {
+        p->~T();
+    }
+};
+
+template <typename T, typename U>
+inline bool operator==(const freelist_allocator<T>&, const freelist_allocator<U>&) {
+    return true;
+}
+
+template <typename T, typename U>
+inline bool operator!=(const freelist_allocator<T>&, const freelist_allocator<U>&) {
+    return false;
+}
+
+}
+
+
+#endif
@@ -0,0 +1,251 @@
+#ifndef __CLIENTSERVER_HANDOFF_H
+#define __CLIENTSERVER_HANDOFF_H
+
+
+#include <unistd.h>
+#include <time.h>
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+#include "clientserver.h"
+#include "unix_server.h"
+#include "unix_client.h"
+
+
+namespace clientserver {
+
+
+/*
+ *    .
+ *
+ *      unix-.    
+ *   (SCM_RIGHTS);    accept  ,   
+ *    . ,      
+ *  ,   keep-alive  (. handoff_idle) 
+ *      unix-.
+ */
+
+
+//  .
+
+class handoff_offer {
+
+    server_socket& server;
+    unix_server_socket channel;
+
+    bool done;
+    boost::mutex m_lock;
+    boost::condition_variable m_cond;
+
+    void wait_successor() {
+
+        while (1) {
+
+            try {
+
+                struct sockaddr_in peer;
+                int c = channel.accept_client(peer);
+
+                try {
+                    send_fd(c, server.fd, 'L');
+
+                } catch (...) {
+                    ::close(c);
+                    throw;
+                }
+
+                server.hand_off_to(c);
+
+                {
+                    boost::mutex::scoped_lock l(m_lock);
+                    done = true;
+                }
+
+                m_cond.notify_all();
+                return;
+
+            } catch (std::exception& e) {
+                logger::log(logger::ERROR) << "ERROR in handoff : " << e.what();
+
+            } catch (...) {
+                logger::log(logger::ERROR) << "UNKNOWN ERROR in handoff";
+            }
+        }
+    }
+
+public:
+
+    handoff_offer(server_socket& s, const std::string& path) : server(s), channel(path), done(false) {
+        boost::thread th(boost::bind(&handoff_offer::wait_successor, this));
+    }
+
+    bool handed_off() {
+        boost::mutex::scoped_lock l(m_lock);
+        return done;
+    }
+
+    void wait() {
+        boost::mutex::scoped_lock l(m_lock);
+
+        while (!done)
+            m_cond.wait(l);
+    }
+
+    //    . timeout  , 0 --   .
+    //  false,   timeout   .
+    bool drain(unsigned int timeout = 0) {
+
+        struct timespec ts;
+        ts.tv_sec = 0;
+        ts.tv_nsec = 10 * 1000 * 1000;
+
+        for (unsigned int t = 0; server.connections() > 0; t += 10) {
+
+            if (timeout > 0 && t >= timeout)
+                return false;
+
+            ::nanosleep(&ts, NULL);
+        }
+
+        return true;
+    }
+};
+
+
+//  keep-alive  ,        .
+//   ;   true --    ,   .
+
+inline bool handoff_idle(server_socket& server, service_buffer sock) {
+
+    if (!server.handed_off() || sock->available() > 0)
+        return false;
+
+    sock->m_obj->timer.stop();
+
+    int fd = sock->m_obj->fd;
+    sock->m_obj->fd = -1;
+
+    server.hand_off(fd);
+    return true;
+}
+
+
+
+//  .
+
+class handed_server_socket : public server_socket {
+public:
+
+    handed_server_socket(int listener) : server_socket(0U, 0U, false) {
+        fd = listener;
+    }
+};
+
+
+namespace {
+
+template <typename F>
+inline void receive_handed_off_(boost::shared_ptr<server_socket> server, boost::shared_ptr<unix_client_socket> channel,
+                                F service, bool priority) {
+
+    while (1) {
+
+        try {
+
+            char tag;
+            int client = recv_fd(channel->fd, tag);
+
+            if (client < 0)
+                continue;
+
+            if (tag != 'C') {
+                ::close(client);
+                continue;
+            }
+
+            server->adopt(service, client, priority);
+
+        } catch (eof_exception& e) {
+            //  .
+            return;
+
+        } catch (std::exception& e) {
+            logger::log(logger::ERROR) << "ERROR in handoff : " << e.what();
+            return;
+
+        } catch (...) {
+            logger::log(logger::ERROR) << "UNKNOWN ERROR in handoff";
+            return;
+        }
+    }
+}
+
+}
+
+
+//     ,   path.
+//   --  ,     .
+
+template <typename F>
+inline boost::shared_ptr<server_socket> take_over(const std::string& path, F service, bool priority = false) {
+
+    boost::shared_ptr<server_socket> ret;
+    boost::shared_ptr<unix_client_socket> channel;
+
+    try {
+        channel.reset(new unix_client_socket(path, 0, 0));
+
+    } catch (std::exception& e) {
+        return ret;
+    }
+
+    char tag;
+    int listener = recv_fd(channel->fd, tag);
+
+    if (listener >= 0 && tag != 'L') {
+        ::close(listener);
+        listener = -1;
+    }
+
+    if (listener < 0)
+        throw std::runtime_error("take_over(): no listening socket from " + path);
+
+    ret.reset(new handed_server_socket(listener));
+
+    boost::thread th(boost::bind<void>(&receive_handed_off_<F>, ret, channel, service, priority));
+    return ret;
+}
+
+}
+
+/*
+
+    :
+
+     util::daemonize(pidfile, info_log, error_log, true, true);
+
+     boost::shared_ptr<server_socket> server = take_over("/var/run/app.handoff", service);
+
+     if (!server)
+         server.reset(new server_socket("0.0.0.0", 9876));
+
+     handoff_offer offer(*server, "/var/run/app.handoff");
+     serve(*server, service);
+
+     offer.wait();        //  
+     offer.drain(30000);  //   
+     return 0;
+
+     keep-alive ,   :
+
+     if (handoff_idle(*server, sock))
+         return;
+
+ */
+
+
+#endif
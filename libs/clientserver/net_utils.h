@@ -10,7 +10,6 @@
 #include <netdb.h>
 
 #include <sys/ioctl.h>
-#include <stropts.h>
 #include <net/if.h>
 
 #include <string.h>
@@ -0,0 +1,138 @@
+#ifndef __CLIENTSERVER_REUSEPORT_H
+#define __CLIENTSERVER_REUSEPORT_H
+
+
+#include <unistd.h>
+#include <linux/filter.h>
+
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include "clientserver.h"
+
+
+namespace clientserver {
+
+
+/*
+ *       (SO_REUSEPORT).
+ *
+ *        ;  
+ *    accept,    . 
+ *     accept.
+ */
+
+class sharded_server {
+
+    std::vector<boost::shared_ptr<server_socket> > shards;
+
+public:
+
+    // nshards == 0 --      .
+    sharded_server(const std::string& host, int port, unsigned int nshards = 0,
+                   unsigned int rtimeout = 0, unsigned int stimeout = 0) {
+
+        if (nshards == 0)
+            nshards = ncpus();
+
+        for (unsigned int i = 0; i < nshards; ++i) {
+            shards.push_back(boost::shared_ptr<server_socket>(
+                                 new server_socket(host, port, rtimeout, stimeout, true)));
+        }
+    }
+
+    static unsigned int ncpus() {
+        long n = ::sysconf(_SC_NPROCESSORS_ONLN);
+        return (n > 0 ? n : 1);
+    }
+
+    size_t size() const {
+        return shards.size();
+    }
+
+    server_socket& operator[](size_t i) {
+        return *(shards[i]);
+    }
+
+    //    ,    (,  ) % size().
+    //       bind(), ..   shards.
+    //
+    //       :      
+    //   ,         ,   .
+    //       .
+    void steer_by_cpu() {
+
+        if (shards.size() != ncpus()) {
+            logger::log(logger::ERROR) << "WARNING: steer_by_cpu() needs one socket per CPU, not steering. ("
+                                       << shards.size() << " sockets, " << ncpus() << " CPUs)";
+            return;
+        }
+
+        struct sock_filter code[] = {
+            { BPF_LD  | BPF_W | BPF_ABS, 0, 0, (unsigned int)(SKF_AD_OFF + SKF_AD_CPU) },
+            { BPF_ALU | BPF_MOD | BPF_K, 0, 0, (unsigned int)shards.size() },
+            { BPF_RET | BPF_A, 0, 0, 0 }
+        };
+
+        struct sock_fprog prog;
+        prog.len = sizeof(code) / sizeof(code[0]);
+        prog.filter = code;
+
+        if (::setsockopt(shards[0]->fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog)) < 0)
+            throw error::system_error("could not setsockopt(SO_ATTACH_REUSEPORT_CBPF) : ");
+
+        for (size_t i = 0; i < shards.size(); ++i) {
+            int cpu = i;
+
+            if (::setsockopt(shards[i]->fd, SOL_SOCKET, SO_INCOMING_CPU, &cpu, sizeof(cpu)) < 0)
+                logger::log(logger::ERROR) << "WARNING: setsockopt(SO_INCOMING_CPU) failed. (" << cpu << ")";
+        }
+    }
+};
+
+
+namespace {
+
+template <typename F>
+inline void serve_shard_(server_socket* server, F service, size_t maxconns, bool priority, int cpu) {
+
+    if (cpu >= 0)
+        set_cpu_affinity(cpu);
+
+    server->serve(service, maxconns, priority);
+}
+
+}
+
+
+// : maxconns     .
+
+template <typename F>
+inline void serve_sharded(sharded_server& server, F service, size_t maxconns = 0, bool priority = false,
+                          bool pin = true) {
+
+    for (size_t i = 0; i < server.size(); ++i) {
+
+        int cpu = (pin ? (int)(i % sharded_server::ncpus()) : -1);
+
+        boost::thread th(boost::bind<void>(&serve_shard_<F>, &(server[i]), service, maxconns, priority, cpu));
+    }
+}
+
+}
+
+/*
+
+    :
+
+     sharded_server server("0.0.0.0", 9876);
+     server.steer_by_cpu();
+     serve_sharded(server, service, 1000);
+
+ */
+
+
+#endif
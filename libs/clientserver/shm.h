@@ -0,0 +1,581 @@
+#ifndef __CLIENTSERVER_SHM_H
+#define __CLIENTSERVER_SHM_H
+
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/poll.h>
+#include <linux/futex.h>
+#include <time.h>
+
+#include <string>
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include "clientserver.h"
+#include "unix_server.h"
+#include "unix_client.h"
+
+
+namespace clientserver {
+
+
+/*
+ *         .
+ *
+ *   memfd    (    )   
+ *   unix- (SCM_RIGHTS, . send_fd()).   
+ *     ; futex --    
+ * . Unix-  :   ,   .
+ *
+ *   --     ,      
+ * buffer<T>;   --  memfd,   .
+ *
+ *   : memfd      ( 
+ *      -- SIGBUS),   ,   
+ * ,      .
+ *
+ * shm_socket   T  buffer<T>: serialization::save/load 
+ * httpd::parse_request()     .
+ */
+
+
+namespace {
+
+inline int futex_(volatile int* addr, int op, int val, const struct timespec* ts) {
+    return ::syscall(SYS_futex, addr, op, val, ts, NULL, 0);
+}
+
+}
+
+
+//    . head  tail --     
+// (  2^32),    futex'.     size ,
+//   :    .
+
+class shm_ring {
+public:
+
+    struct header {
+        volatile int head;
+        char pad1[64 - sizeof(int)];
+
+        volatile int tail;
+        char pad2[64 - sizeof(int)];
+
+        volatile int reader_waits;
+        volatile int writer_waits;
+        volatile int closed;
+        char pad3[64 - 3 * sizeof(int)];
+    };
+
+private:
+
+    header* h;
+    unsigned char* data;
+    unsigned int size;
+
+    void wake_(volatile int* word, volatile int* waits) {
+
+        __sync_synchronize();
+
+        if (*waits) {
+            *waits = 0;
+            futex_(word, FUTEX_WAKE, 1, NULL);
+        }
+    }
+
+public:
+
+    shm_ring() : h(NULL), data(NULL), size(0) {}
+
+    //     sz ( ).
+    static size_t footprint(unsigned int sz) {
+        return sizeof(header) + sz;
+    }
+
+    void attach(void* mem, unsigned int sz) {
+        h = (header*)mem;
+        data = (unsigned char*)mem + sizeof(header);
+        size = sz;
+    }
+
+    //  head - tail ;  size --  .
+    unsigned int used_(unsigned int head, unsigned int tail) const {
+        return head - tail;
+    }
+
+    unsigned int readable() const {
+        unsigned int ret = used_(h->head, h->tail);
+        return (ret > size ? 0 : ret);
+    }
+
+    unsigned int writable() const {
+        unsigned int ret = used_(h->head, h->tail);
+        return (ret > size ? 0 : size - ret);
+    }
+
+    bool closed() const {
+        return h->closed || used_(h->head, h->tail) > size;
+    }
+
+    void close() {
+        h->closed = 1;
+        __sync_synchronize();
+
+        futex_(&h->head, FUTEX_WAKE, 1, NULL);
+        futex_(&h->tail, FUTEX_WAKE, 1, NULL);
+    }
+
+    //  :     .
+
+    size_t write(const void* p, size_t len) {
+
+        unsigned int head = h->head;
+        unsigned int used = used_(head, h->tail);
+
+        if (used > size) return 0;
+
+        unsigned int n = size - used;
+
+        if (len < n) n = len;
+        if (n == 0) return 0;
+
+        unsigned int off = head & (size - 1);
+        unsigned int first = (n < size - off ? n : size - off);
+
+        ::memcpy(data + off, p, first);
+        ::memcpy(data, (const unsigned char*)p + first, n - first);
+
+        __sync_synchronize();
+        h->head = head + n;
+
+        wake_(&h->head, &h->reader_waits);
+        return n;
+    }
+
+    size_t read(void* p, size_t len) {
+
+        unsigned int tail = h->tail;
+        unsigned int n = used_(h->head, tail);
+
+        if (n > size) return 0;
+
+        if (len < n) n = len;
+        if (n == 0) return 0;
+
+        __sync_synchronize();
+
+        unsigned int off = tail & (size - 1);
+        unsigned int first = (n < size - off ? n : size - off);
+
+        ::memcpy(p, data + off, first);
+        ::memcpy((unsigned char*)p + first, data, n - first);
+
+        __sync_synchronize();
+        h->tail = tail + n;
+
+        wake_(&h->tail, &h->writer_waits);
+        return n;
+    }
+
+    // ,  *word == seen,    ms.  ,  :
+    //      ,     .
+
+    void wait_read(unsigned int ms) {
+
+        h->reader_waits = 1;
+        __sync_synchronize();
+
+        int seen = h->head;
+
+        if ((unsigned int)seen != (unsigned int)h->tail || h->closed) {
+            h->reader_waits = 0;
+            return;
+        }
+
+        struct timespec ts;
+        ts.tv_sec = ms / 1000;
+        ts.tv_nsec = (ms % 1000) * 1000 * 1000;
+
+        futex_(&h->head, FUTEX_WAIT, seen, &ts);
+    }
+
+    void wait_write(unsigned int ms) {
+
+        h->writer_waits = 1;
+        __sync_synchronize();
+
+        int seen = h->tail;
+
+        if (writable() > 0 || h->closed) {
+            h->writer_waits = 0;
+            return;
+        }
+
+        struct timespec ts;
+        ts.tv_sec = ms / 1000;
+        ts.tv_nsec = (ms % 1000) * 1000 * 1000;
+
+        futex_(&h->tail, FUTEX_WAIT, seen, &ts);
+    }
+};
+
+
+
+//    .  --   unknown_socket.
+
+class shm_socket {
+
+    //    ,     futex'.    --
+    //  :   ,      .
+    static unsigned int spin_() {
+        static unsigned int ret = (::sysconf(_SC_NPROCESSORS_ONLN) > 1 ? 2000 : 0);
+        return ret;
+    }
+
+    //  ,     .
+    static void pause_() {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#elif defined(__aarch64__)
+        __asm__ __volatile__ ("yield");
+#endif
+    }
+
+    //  , , ,   .
+    static const unsigned int CHECK_MS = 50;
+
+    void* mem;
+    size_t mem_size;
+
+    shm_ring in;
+    shm_ring out;
+
+    unsigned int rcv_timeout;
+
+    //   unix- -- ,  (  ).
+    bool peer_gone_() {
+
+        struct pollfd pfd;
+        pfd.fd = fd;
+        pfd.events = POLLRDHUP;
+        pfd.revents = 0;
+
+        return (::poll(&pfd, 1, 0) > 0 && (pfd.revents & (POLLRDHUP | POLLHUP | POLLERR)));
+    }
+
+    shm_socket(const shm_socket&);
+    shm_socket& operator=(const shm_socket&);
+
+public:
+
+    // Unix-  .
+    int fd;
+
+    // client --    :    .
+    shm_socket(int sock, int memfd, bool client, unsigned int rtimeout = 0) :
+        mem(MAP_FAILED), mem_size(0), rcv_timeout(rtimeout), fd(sock) {
+
+        struct stat st;
+
+        if (::fstat(memfd, &st) < 0) {
+            ::close(fd);
+            throw error::system_error("could not fstat() : ");
+        }
+
+        int seals = ::fcntl(memfd, F_GET_SEALS);
+
+        if (seals < 0 || !(seals & F_SEAL_SHRINK)) {
+            ::close(fd);
+            throw std::runtime_error("shm_socket(): memfd is not sealed against shrinking");
+        }
+
+        mem_size = st.st_size;
+        mem = ::mmap(NULL, mem_size, PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+
+        if (mem == MAP_FAILED) {
+            ::close(fd);
+            throw error::system_error("could not mmap() : ");
+        }
+
+        unsigned int sz = mem_size / 2 - sizeof(shm_ring::header);
+
+        if (mem_size < 2 * shm_ring::footprint(4096) || (sz & (sz - 1)) != 0) {
+            ::munmap(mem, mem_size);
+            ::close(fd);
+            throw std::runtime_error("shm_socket(): bad ring size");
+        }
+
+        void* first = mem;
+        void* second = (unsigned char*)mem + shm_ring::footprint(sz);
+
+        out.attach(client ? first : second, sz);
+        in.attach(client ? second : first, sz);
+    }
+
+    ~shm_socket() {
+        out.close();
+        in.close();
+
+        ::munmap(mem, mem_size);
+        ::close(fd);
+    }
+
+    void send(const void* data, size_t len) {
+
+        const unsigned char* p = (const unsigned char*)data;
+        unsigned int spin = 0;
+
+        while (len > 0) {
+
+            if (out.closed())
+                throw send_error("could not send() : peer closed shared memory");
+
+            size_t n = out.write(p, len);
+
+            if (n > 0) {
+                p += n;
+                len -= n;
+                spin = 0;
+                continue;
+            }
+
+            if (spin++ < spin_()) {
+                pause_();
+                continue;
+            }
+
+            if (peer_gone_())
+                throw send_error("could not send() : peer is gone");
+
+            out.wait_write(CHECK_MS);
+        }
+    }
+
+    void sendv(struct iovec* iov, size_t n, bool) {
+
+        for (size_t i = 0; i < n; ++i)
+            send(iov[i].iov_base, iov[i].iov_len);
+    }
+
+    size_t recv(void* buff, size_t len) {
+
+        unsigned long long deadline = (rcv_timeout > 0 ? monotonic_usec() + rcv_timeout * 1000ULL : 0);
+        unsigned int spin = 0;
+
+        while (1) {
+
+            size_t n = in.read(buff, len);
+
+            if (n > 0)
+                return n;
+
+            if (in.closed())
+                throw eof_exception();
+
+            if (spin++ < spin_()) {
+                pause_();
+                continue;
+            }
+
+            if (peer_gone_()) {
+
+                // ,    ,   .
+                if (in.readable() > 0)
+                    continue;
+
+                throw eof_exception();
+            }
+
+            if (deadline > 0 && monotonic_usec() >= deadline)
+                throw recv_error("could not recv() : timeout");
+
+            in.wait_read(CHECK_MS);
+        }
+    }
+
+    size_t recv_nowait(void* buff, size_t len) {
+
+        size_t n = in.read(buff, len);
+
+        if (n == 0 && in.closed())
+            throw eof_exception();
+
+        return n;
+    }
+};
+
+
+typedef boost::shared_ptr<buffer<shm_socket> > shm_buffer;
+
+
+//    (serve_shm)  unix- path. ring_size --  .
+
+inline shm_buffer shm_connect(const std::string& path, unsigned int ring_size = 1024 * 1024, unsigned int rtimeout = 0) {
+
+    unix_client_socket channel(path, 0, 0, SOCK_SEQPACKET);
+
+    int memfd = ::memfd_create("clientserver-shm", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+
+    if (memfd < 0)
+        throw error::system_error("could not memfd_create() : ");
+
+    //  memfd   --  ,     .
+    if (::ftruncate(memfd, 2 * shm_ring::footprint(ring_size)) < 0) {
+        ::close(memfd);
+        throw error::system_error("could not ftruncate() : ");
+    }
+
+    //       :    memfd  .
+    if (::fcntl(memfd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) < 0) {
+        ::close(memfd);
+        throw error::system_error("could not fcntl(F_ADD_SEALS) : ");
+    }
+
+    try {
+        send_fd(channel.fd, memfd, 'S');
+
+    } catch (...) {
+        ::close(memfd);
+        throw;
+    }
+
+    boost::shared_ptr<shm_socket> s;
+
+    try {
+        s.reset(new shm_socket(channel.fd, memfd, true, rtimeout));
+
+    } catch (...) {
+        channel.fd = -1;
+        ::close(memfd);
+        throw;
+    }
+
+    //  unix-   shm_socket;  memfd  close().
+    channel.fd = -1;
+    ::close(memfd);
+
+    return shm_buffer(new buffer<shm_socket>(s));
+}
+
+
+
+// :    unix- (SOCK_SEQPACKET),  -- .
+
+namespace {
+
+template <typename F>
+inline void serve_shm_client_(F f, int client, unsigned int rtimeout) {
+
+    try {
+
+        char tag;
+        int memfd = -1;
+
+        try {
+            memfd = recv_fd(client, tag);
+
+        } catch (...) {
+            ::close(client);
+            throw;
+        }
+
+        if (memfd < 0 || tag != 'S') {
+            if (memfd >= 0) ::close(memfd);
+            ::close(client);
+            return;
+        }
+
+        boost::shared_ptr<shm_socket> s;
+
+        try {
+            s.reset(new shm_socket(client, memfd, false, rtimeout));
+
+        } catch (...) {
+            ::close(memfd);
+            throw;
+        }
+
+        ::close(memfd);
+
+        f(shm_buffer(new buffer<shm_socket>(s)));
+
+    } catch (eof_exception& e) {
+
+    } catch (std::exception& e) {
+        logger::log(logger::ERROR) << "ERROR in shm serving : " << e.what();
+
+    } catch (...) {
+        logger::log(logger::ERROR) << "UNKNOWN ERROR in shm serving";
+    }
+}
+
+}
+
+
+template <typename F>
+inline void serve_shm_blocking(unix_server_socket& server, F f, unsigned int rtimeout = 0) {
+
+    while (1) {
+
+        try {
+
+            struct sockaddr_in peer;
+            int client = server.accept_client(peer);
+
+            boost::thread(boost::bind<void>(&serve_shm_client_<F>, f, client, rtimeout));
+
+        } catch (std::exception& e) {
+            logger::log(logger::ERROR) << "ERROR in serving : " << e.what();
+
+        } catch (...) {
+            logger::log(logger::ERROR) << "UNKNOWN ERROR in serving";
+        }
+    }
+}
+
+template <typename F>
+inline void serve_shm(unix_server_socket& server, F f, unsigned int rtimeout = 0) {
+    boost::thread th(boost::bind<void>(&serve_shm_blocking<F>, boost::ref(server), f, rtimeout));
+}
+
+}
+
+/*
+
+    :
+
+     void service(shm_buffer sock) {
+         httpd::request req;
+         httpd::parse_request(sock, req);
+
+         response::headers h;
+         ...
+         sock->cork();
+         sock << head << body;
+         sock->send_pending();
+     }
+
+     unix_server_socket server("/var/run/app.shm", 0, 0, SOCK_SEQPACKET);
+     serve_shm(server, service);
+
+     // .
+     shm_buffer sock = shm_connect("/var/run/app.shm");
+
+     serialization::saver_string_policy out;
+     serialization::save(out, request);
+
+     sock << out.data;
+     sock->send_pending();
+     serialization::load(sock, reply);
+
+ */
+
+
+#endif
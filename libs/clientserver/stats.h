@@ -0,0 +1,85 @@
+#ifndef __CLIENTSERVER_STATS_H
+#define __CLIENTSERVER_STATS_H
+
+
+#include "metrics/metrics.h"
+
+
+namespace clientserver {
+
+//   (. metrics/metrics.h).    .
+
+namespace stats {
+
+inline metrics::counter& accepted() {
+    static metrics::counter& ret = metrics::get_counter("clientserver_accepted_total", "Connections accepted.");
+    return ret;
+}
+
+inline metrics::gauge& active() {
+    static metrics::gauge& ret = metrics::get_gauge("clientserver_connections_active", "Open server connections.");
+    return ret;
+}
+
+inline metrics::gauge& idle() {
+    static metrics::gauge& ret = metrics::get_gauge("clientserver_connections_idle", "Server connections waiting for the next request.");
+    return ret;
+}
+
+inline metrics::counter& bytes_in() {
+    static metrics::counter& ret = metrics::get_counter("clientserver_received_bytes_total", "Bytes received from sockets.");
+    return ret;
+}
+
+inline metrics::counter& bytes_out() {
+    static metrics::counter& ret = metrics::get_counter("clientserver_sent_bytes_total", "Bytes sent to sockets.");
+    return ret;
+}
+
+// TCP Fast Open (. server_socket::set_fastopen(), client_socket):  
+//       SYN,     
+//    ( cookie,    ).
+
+inline metrics::counter& fastopen_accepted() {
+    static metrics::counter& ret = metrics::get_counter("clientserver_fastopen_accepted_total", "Connections accepted with data in the SYN.");
+    return ret;
+}
+
+inline metrics::counter& fastopen_connected() {
+    static metrics::counter& ret = metrics::get_counter("clientserver_fastopen_connected_total", "Client connections whose first data was acked in the SYN.");
+    return ret;
+}
+
+inline metrics::counter& fastopen_fallback() {
+    static metrics::counter& ret = metrics::get_counter("clientserver_fastopen_fallback_total", "Client connections that asked for Fast Open and did a full handshake.");
+    return ret;
+}
+
+//  : read --  , handle -- , write --  .
+
+inline metrics::histogram& stage(const char* name) {
+    return metrics::get_histogram("clientserver_request_stage_seconds", "Time spent in each request stage.",
+                                  std::string("stage=\"") + name + "\"");
+}
+
+inline metrics::histogram& stage_read() {
+    static metrics::histogram& ret = stage("read");
+    return ret;
+}
+
+inline metrics::histogram& stage_handle() {
+    static metrics::histogram& ret = stage("handle");
+    return ret;
+}
+
+inline metrics::histogram& stage_write() {
+    static metrics::histogram& ret = stage("write");
+    return ret;
+}
+
+}
+
+}
+
+
+#endif
@@ -0,0 +1,226 @@
+#ifndef __CLIENTSERVER_THREAD_POOL_H
+#define __CLIENTSERVER_THREAD_POOL_H
+
+
+#include <deque>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+#include "clientserver.h"
+#include "affinity.h"
+
+
+namespace clientserver {
+
+
+//   .   ,  .
+
+template <typename T>
+class bounded_queue {
+
+    std::deque<T> m_queue;
+    size_t m_max;
+
+    boost::mutex m_lock;
+    boost::condition_variable m_cond;
+
+public:
+
+    bounded_queue(size_t m) : m_max(m) {}
+
+    bool try_push(const T& t) {
+        {
+            boost::mutex::scoped_lock l(m_lock);
+
+            if (m_queue.size() >= m_max)
+                return false;
+
+            m_queue.push_back(t);
+        }
+
+        m_cond.notify_one();
+        return true;
+    }
+
+    T pop() {
+        boost::mutex::scoped_lock l(m_lock);
+
+        while (m_queue.empty())
+            m_cond.wait(l);
+
+        T ret = m_queue.front();
+        m_queue.pop_front();
+        return ret;
+    }
+
+    size_t size() {
+        boost::mutex::scoped_lock l(m_lock);
+        return m_queue.size();
+    }
+};
+
+
+
+/*
+ *     .
+ *
+ *  accept'     ;   ,
+ *   .   ,     serve().
+ *
+ *   placement,      (. affinity.h).
+ */
+
+template <typename F>
+class pooled_server {
+
+    server_socket& server;
+    F service;
+    bool priority;
+    placement* m_placement;
+
+    typedef std::pair<int, struct sockaddr_in> accepted;
+
+    bounded_queue<accepted> m_queue;
+    std::vector<boost::shared_ptr<boost::thread> > m_threads;
+
+    int busy;
+    unsigned long rejected;
+
+    void worker(unsigned int n) {
+
+        if (priority)
+            set_realtime_priority();
+
+        int node = (m_placement ? m_placement->bind_thread(n) : 0);
+
+        while (1) {
+
+            accepted client = m_queue.pop();
+
+            lockfree::atomic_add(&busy, 1);
+
+            if (m_placement)
+                m_placement->connection_opened(node);
+
+            try {
+                server.setup_client(client.first);
+
+                service_buffer b = make_connection(client.first, n, client.second);
+                server.watch(b);
+
+                service(b);
+
+            } catch (std::exception& e) {
+                logger::log(logger::ERROR) << "ERROR in pooled serving : " << e.what();
+
+            } catch (...) {
+                logger::log(logger::ERROR) << "UNKNOWN ERROR in pooled serving";
+            }
+
+            if (m_placement)
+                m_placement->connection_closed(node);
+
+            lockfree::atomic_add(&busy, -1);
+        }
+    }
+
+public:
+
+    // stack_size == 0 --    .
+    pooled_server(server_socket& s, F f, size_t pool_size, size_t queue_size, size_t stack_size, bool prio,
+                  placement* pl = NULL) :
+        server(s), service(f), priority(prio), m_placement(pl), m_queue(queue_size), busy(0), rejected(0) {
+
+        if (pool_size == 0) pool_size = 1;
+
+        boost::thread::attributes attrs;
+
+        if (stack_size > 0)
+            attrs.set_stack_size(stack_size);
+
+        for (size_t i = 0; i < pool_size; ++i) {
+            m_threads.push_back(boost::shared_ptr<boost::thread>(
+                                    new boost::thread(attrs, boost::bind(&pooled_server::worker, this, i))));
+        }
+    }
+
+    size_t busy_threads() {
+        return lockfree::atomic_add(&busy, 0);
+    }
+
+    size_t queued() {
+        return m_queue.size();
+    }
+
+    unsigned long rejected_count() {
+        return lockfree::atomic_add(&rejected, 0UL);
+    }
+
+    void serve() {
+
+        while (1) {
+
+            try {
+
+                accepted client;
+                client.first = server.accept_client(client.second);
+
+                if (!m_queue.try_push(client)) {
+
+                    lockfree::atomic_add(&rejected, 1UL);
+
+                    ::shutdown(client.first, SHUT_RDWR);
+                    ::close(client.first);
+                }
+
+            } catch (std::exception& e) {
+                logger::log(logger::ERROR) << "ERROR in serving : " << e.what();
+
+            } catch (...) {
+                logger::log(logger::ERROR) << "UNKNOWN ERROR in serving";
+            }
+        }
+    }
+};
+
+
+template <typename F>
+inline void serve_pooled_blocking(server_socket& server, F service, size_t pool_size, size_t queue_size,
+                                  size_t stack_size = 0, bool priority = false, placement* pl = NULL) {
+
+    pooled_server<F> ps(server, service, pool_size, queue_size, stack_size, priority, pl);
+    ps.serve();
+}
+
+template <typename F>
+inline void serve_pooled(server_socket& server, F service, size_t pool_size, size_t queue_size,
+                         size_t stack_size = 0, bool priority = false, placement* pl = NULL) {
+
+    boost::thread th(boost::bind<void>(&serve_pooled_blocking<F>,
+                                       boost::ref(server), service,
+                                       pool_size, queue_size, stack_size, priority, pl));
+}
+
+}
+
+/*
+
+    :
+
+     server_socket server("0.0.0.0", 9876);
+
+     // 64   256 ,  1024   .
+     serve_pooled(server, service, 64, 1024, 256*1024);
+
+     //  ,      NUMA-.
+     static placement pl = placement::numa();
+     serve_pooled(server, service, 64, 1024, 256*1024, false, &pl);
+
+ */
+
+
+#endif
@@ -0,0 +1,440 @@
+#ifndef __CLIENTSERVER_TIMER_WHEEL_H
+#define __CLIENTSERVER_TIMER_WHEEL_H
+
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <time.h>
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "stats.h"
+
+
+namespace clientserver {
+
+
+//    .
+
+inline unsigned long long monotonic_usec() {
+
+    struct timespec ts;
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (unsigned long long)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+
+/*
+ *   .
+ *
+ * LEVELS   SLOTS ;  --   . 
+ *    ,      ;   
+ *      . , 
+ *    -- O(1),   :      .
+ *
+ *     ,  tick . expire() 
+ *   :         . 
+ *  cancel()   ,  expire()     .
+ */
+
+class timer_wheel {
+
+    struct node {
+        node* prev;
+        node* next;
+
+        node() : prev(NULL), next(NULL) {}
+    };
+
+public:
+
+    class timer : public node {
+
+        friend class timer_wheel;
+        unsigned long long when;
+
+    public:
+
+        timer() : when(0) {}
+        virtual ~timer() {}
+
+        virtual void expire() = 0;
+
+        bool armed() const {
+            return prev != NULL;
+        }
+    };
+
+private:
+
+    static const unsigned int BITS = 6;
+    static const unsigned int SLOTS = 1 << BITS;
+    static const unsigned int MASK = SLOTS - 1;
+    static const unsigned int LEVELS = 4;
+
+    node slots[LEVELS][SLOTS];
+
+    boost::mutex m_lock;
+
+    unsigned int tick;
+    unsigned long long start;
+    unsigned long long now;
+
+    size_t m_size;
+    unsigned long expired;
+
+    bool stop;
+    boost::thread m_thread;
+
+    static unsigned long long clock_() {
+        return monotonic_usec() / 1000;
+    }
+
+    static void unlink_(node* n) {
+        n->prev->next = n->next;
+        n->next->prev = n->prev;
+        n->prev = NULL;
+        n->next = NULL;
+    }
+
+    //    .  .
+    void place_(timer* t) {
+
+        if (t->when <= now)
+            t->when = now + 1;
+
+        unsigned long long delta = t->when - now;
+        unsigned int level = 0;
+
+        while (level < LEVELS - 1 && delta >= (1ULL << (BITS * (level + 1))))
+            ++level;
+
+        // ,   , --   .
+        if (delta >= (1ULL << (BITS * LEVELS)))
+            t->when = now + (1ULL << (BITS * LEVELS)) - 1;
+
+        node* head = &slots[level][(t->when >> (BITS * level)) & MASK];
+
+        t->prev = head->prev;
+        t->next = head;
+        head->prev->next = t;
+        head->prev = t;
+    }
+
+    //    level   .
+    void cascade_(unsigned int level) {
+
+        node* head = &slots[level][(now >> (BITS * level)) & MASK];
+
+        while (head->next != head) {
+            timer* t = (timer*)head->next;
+            unlink_(t);
+            place_(t);
+        }
+    }
+
+    //  .  .
+    void advance_() {
+
+        ++now;
+
+        for (unsigned int level = 1; level < LEVELS; ++level) {
+
+            if (((now >> (BITS * (level - 1))) & MASK) != 0)
+                break;
+
+            cascade_(level);
+        }
+
+        node* head = &slots[0][now & MASK];
+
+        while (head->next != head) {
+            timer* t = (timer*)head->next;
+            unlink_(t);
+            --m_size;
+            ++expired;
+
+            try {
+                t->expire();
+            } catch (...) {}
+        }
+    }
+
+    void run() {
+
+        struct timespec ts;
+        ts.tv_sec = tick / 1000;
+        ts.tv_nsec = (tick % 1000) * 1000 * 1000;
+
+        while (1) {
+
+            ::nanosleep(&ts, NULL);
+
+            unsigned long long target = (clock_() - start) / tick;
+
+            boost::mutex::scoped_lock l(m_lock);
+
+            if (stop)
+                return;
+
+            while (now < target)
+                advance_();
+        }
+    }
+
+    timer_wheel(const timer_wheel&);
+    timer_wheel& operator=(const timer_wheel&);
+
+public:
+
+    // tick  :  .
+    timer_wheel(unsigned int t = 10) : tick(t > 0 ? t : 1), start(clock_()), now(0), m_size(0), expired(0), stop(false) {
+
+        for (unsigned int i = 0; i < LEVELS; ++i) {
+            for (unsigned int j = 0; j < SLOTS; ++j) {
+                slots[i][j].prev = &slots[i][j];
+                slots[i][j].next = &slots[i][j];
+            }
+        }
+
+        m_thread = boost::thread(boost::bind(&timer_wheel::run, this));
+    }
+
+    ~timer_wheel() {
+        {
+            boost::mutex::scoped_lock l(m_lock);
+            stop = true;
+        }
+
+        m_thread.join();
+    }
+
+    //    ms .   -- .
+    void set(timer& t, unsigned int ms) {
+
+        boost::mutex::scoped_lock l(m_lock);
+
+        if (t.armed())
+            unlink_(&t);
+        else
+            ++m_size;
+
+        //   ,    now:        .
+        t.when = (clock_() - start + ms + tick - 1) / tick;
+        place_(&t);
+    }
+
+    void cancel(timer& t) {
+
+        boost::mutex::scoped_lock l(m_lock);
+
+        if (!t.armed())
+            return;
+
+        unlink_(&t);
+        --m_size;
+    }
+
+    size_t size() {
+        boost::mutex::scoped_lock l(m_lock);
+        return m_size;
+    }
+
+    unsigned long expired_count() {
+        boost::mutex::scoped_lock l(m_lock);
+        return expired;
+    }
+};
+
+
+
+//    ; 0 --  .
+//   idle --    (   );
+//   header --  ,      ;
+//   handler --     .
+
+struct connection_timeouts {
+    unsigned int idle;
+    unsigned int header;
+    unsigned int handler;
+
+    connection_timeouts(unsigned int i = 0, unsigned int h = 0, unsigned int r = 0) :
+        idle(i), header(h), handler(r) {}
+};
+
+
+//       (. admission.h): request_started() -- 
+// , request_done() --  ; usec --    .
+//   ,  .
+
+struct request_observer {
+    virtual void request_started() = 0;
+    virtual void request_done(unsigned long long usec) = 0;
+    virtual ~request_observer() {}
+};
+
+
+//  .       (. stats.h): 
+//         --    .
+//
+//     shutdown() : , 
+//  recv(),   ,  epoll  io_uring -- ,   
+//  ,     .
+
+class connection_timer : public timer_wheel::timer {
+
+    const int& fd;
+
+    timer_wheel* wheel;
+    connection_timeouts to;
+
+    bool m_expired;
+
+    enum phase_t { IDLE, READING, HANDLING };
+
+    phase_t phase;
+    unsigned long long since;
+
+    request_observer* observer;
+    unsigned long long request_start;
+
+    void phase_(phase_t p) {
+
+        if (p == phase)
+            return;
+
+        unsigned long long now = monotonic_usec();
+
+        if (phase == HANDLING && observer != NULL)
+            observer->request_done(now - request_start);
+
+        //           .
+        if (phase == IDLE || phase == HANDLING)
+            request_start = now;
+
+        if (p == HANDLING && observer != NULL)
+            observer->request_started();
+
+        if (phase == IDLE)
+            stats::idle().add(-1);
+        else if (phase == READING && p == HANDLING)
+            stats::stage_read().observe(now - since);
+        else if (phase == HANDLING)
+            stats::stage_handle().observe(now - since);
+
+        if (p == IDLE)
+            stats::idle().add(1);
+
+        phase = p;
+        since = now;
+    }
+
+    void expire() {
+        if (fd >= 0)
+            ::shutdown(fd, SHUT_RDWR);
+
+        m_expired = true;
+    }
+
+    void set_(unsigned int ms) {
+
+        if (wheel == NULL)
+            return;
+
+        if (ms == 0)
+            wheel->cancel(*this);
+        else
+            wheel->set(*this, ms);
+    }
+
+    connection_timer(const connection_timer&);
+    connection_timer& operator=(const connection_timer&);
+
+public:
+
+    connection_timer(const int& f) : fd(f), wheel(NULL), m_expired(false), phase(IDLE), since(0),
+                                     observer(NULL), request_start(0) {
+        stats::idle().add(1);
+    }
+
+    ~connection_timer() {
+        if (wheel != NULL)
+            wheel->cancel(*this);
+
+        if (phase == IDLE)
+            stats::idle().add(-1);
+    }
+
+    //   .
+    void attach(timer_wheel& w, const connection_timeouts& t) {
+        wheel = &w;
+        to = t;
+        idle();
+    }
+
+    void idle() {
+        phase_(IDLE);
+        set_(to.idle);
+    }
+
+    void reading() {
+        phase_(READING);
+        set_(to.header);
+    }
+
+    void handling() {
+        phase_(HANDLING);
+        set_(to.handler);
+    }
+
+    void stop() {
+        set_(0);
+    }
+
+    //       ; NULL --  .  
+    //  ,     ,  --  .
+    void observe(request_observer* o) {
+
+        if (phase == HANDLING && observer != NULL)
+            observer->request_done(monotonic_usec() - request_start);
+
+        observer = o;
+
+        if (phase == HANDLING && observer != NULL)
+            observer->request_started();
+    }
+
+    bool expired() const {
+        return m_expired;
+    }
+};
+
+}
+
+/*
+
+    :
+
+     static timer_wheel wheel(10);
+
+     server_socket server("0.0.0.0", 9876);
+
+     // 30    , 5   , 10   .
+     server.set_timeouts(wheel, connection_timeouts(30000, 5000, 10000));
+     serve(server, service);
+
+   httpd::parse_request()  httpd::responder   ;   :
+
+     sock->m_obj->timer.reading();
+     ...
+     sock->m_obj->timer.handling();
+     ...
+     sock->m_obj->timer.idle();
+
+ */
+
+
+#endif
@@ -15,13 +15,15 @@
 namespace clientserver {
 
 
+// type -- SOCK_STREAM  SOCK_SEQPACKET (  , . send_message()).
+
 class unix_client_socket : public unknown_socket {
 public:
 
-    unix_client_socket(const std::string& path, int rcv_timeout, int snd_timeout) : 
+    unix_client_socket(const std::string& path, int rcv_timeout, int snd_timeout, int type = SOCK_STREAM) : 
         unknown_socket(-1) {
 
-	fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+	fd = ::socket(AF_UNIX, type | SOCK_CLOEXEC, 0);
  
 	if (fd < 0) throw error::system_error("could not socket() : ");
 
@@ -55,14 +57,25 @@ public:
         }
 
     }
+
+    void send_message(const std::string& data, const std::vector<int>& fds = std::vector<int>()) {
+        clientserver::send_message(fd, data.data(), data.size(), fds.empty() ? NULL : &fds[0], fds.size());
+    }
+
+    //   max (SOCK_SEQPACKET) -- .
+    void recv_message(std::string& data, std::vector<int>& fds, size_t max = 4096) {
+
+        data.resize(max);
+        data.resize(clientserver::recv_message(fd, &data[0], max, fds));
+    }
 };
 
 
 //  : ,   .
 typedef boost::shared_ptr<buffer<unix_client_socket> > unix_client_buffer;
 
-inline unix_client_buffer unix_connect(const std::string& path, int rtimeout = 0, int stimeout = 0) {
-    boost::shared_ptr<unix_client_socket> s(new unix_client_socket(path, rtimeout, stimeout));
+inline unix_client_buffer unix_connect(const std::string& path, int rtimeout = 0, int stimeout = 0, int type = SOCK_STREAM) {
+    boost::shared_ptr<unix_client_socket> s(new unix_client_socket(path, rtimeout, stimeout, type));
     return unix_client_buffer(new buffer<unix_client_socket>(s));
 }
 
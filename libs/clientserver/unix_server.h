@@ -8,17 +8,20 @@
 namespace clientserver {
 
 
+// type -- SOCK_STREAM  SOCK_SEQPACKET;     .
+
 class unix_server_socket : public server_socket {
 
 protected:
 
 public:
 
-    unix_server_socket(const std::string& path, unsigned int rtimeout = 0, unsigned int stimeout = 0) : 
+    unix_server_socket(const std::string& path, unsigned int rtimeout = 0, unsigned int stimeout = 0,
+                       int type = SOCK_STREAM) : 
         server_socket(rtimeout, stimeout, false) {
 
 
-	fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+	fd = ::socket(AF_UNIX, type | SOCK_CLOEXEC, 0);
 
 	if (fd < 0) throw error::system_error("could not socket() : ");
 
@@ -0,0 +1,1169 @@
+#ifndef __CLIENTSERVER_URING_H
+#define __CLIENTSERVER_URING_H
+
+
+#include <unistd.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+#include <string>
+#include <vector>
+#include <deque>
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+#include "clientserver.h"
+#include "evented.h"
+#include "files/files_base.h"
+
+
+namespace clientserver {
+
+
+/*
+ * -  io_uring.
+ *
+ *  liburing:        .
+ * : multishot accept   , multishot recv   
+ *   (provided buffers),  --   . , 
+ *    ,     io_uring_enter(),   
+ *    .
+ *
+ * :   ,     --  .
+ *
+ *    ( io_uring ), serve_uring()   serve_evented();
+ *     ,     .
+ *
+ *      ,   :   
+ *   , ,     (. uring_connection::recv()),
+ *    .     
+ *  ;   --        .
+ */
+
+
+class uring {
+
+    int m_fd;
+
+    unsigned char* sq_ptr;
+    unsigned char* cq_ptr;
+    size_t sq_size;
+    size_t cq_size;
+
+    unsigned* sq_head;
+    unsigned* sq_tail;
+    unsigned* sq_mask;
+    unsigned* sq_array;
+    unsigned sq_entries;
+
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned* cq_mask;
+    struct io_uring_cqe* cqes;
+
+    struct io_uring_sqe* sqes;
+    size_t sqes_size;
+
+    //    ;    submit().
+    unsigned m_tail;
+
+    // .
+    uring(const uring&);
+    uring& operator=(const uring&);
+
+public:
+
+    uring(unsigned entries, unsigned flags = 0) : sq_ptr(NULL), cq_ptr(NULL), sqes(NULL) {
+
+        struct io_uring_params p;
+        ::memset(&p, 0, sizeof(p));
+        p.flags = flags;
+
+        m_fd = ::syscall(__NR_io_uring_setup, entries, &p);
+
+        if (m_fd < 0)
+            throw error::system_error("could not io_uring_setup() : ");
+
+        sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+
+        if (p.features & IORING_FEAT_SINGLE_MMAP) {
+            if (cq_size > sq_size) sq_size = cq_size;
+            cq_size = sq_size;
+        }
+
+        sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+
+        void* tmp = ::mmap(NULL, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQ_RING);
+
+        if (tmp == MAP_FAILED) {
+            ::close(m_fd);
+            throw error::system_error("could not mmap() io_uring : ");
+        }
+
+        sq_ptr = (unsigned char*)tmp;
+
+        if (p.features & IORING_FEAT_SINGLE_MMAP) {
+            cq_ptr = sq_ptr;
+
+        } else {
+            tmp = ::mmap(NULL, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_CQ_RING);
+
+            if (tmp == MAP_FAILED) {
+                ::munmap(sq_ptr, sq_size);
+                ::close(m_fd);
+                throw error::system_error("could not mmap() io_uring : ");
+            }
+
+            cq_ptr = (unsigned char*)tmp;
+        }
+
+        tmp = ::mmap(NULL, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQES);
+
+        if (tmp == MAP_FAILED) {
+            if (cq_ptr != sq_ptr) ::munmap(cq_ptr, cq_size);
+            ::munmap(sq_ptr, sq_size);
+            ::close(m_fd);
+            throw error::system_error("could not mmap() io_uring : ");
+        }
+
+        sqes = (struct io_uring_sqe*)tmp;
+
+        sq_head = (unsigned*)(sq_ptr + p.sq_off.head);
+        sq_tail = (unsigned*)(sq_ptr + p.sq_off.tail);
+        sq_mask = (unsigned*)(sq_ptr + p.sq_off.ring_mask);
+        sq_array = (unsigned*)(sq_ptr + p.sq_off.array);
+        sq_entries = p.sq_entries;
+
+        cq_head = (unsigned*)(cq_ptr + p.cq_off.head);
+        cq_tail = (unsigned*)(cq_ptr + p.cq_off.tail);
+        cq_mask = (unsigned*)(cq_ptr + p.cq_off.ring_mask);
+        cqes = (struct io_uring_cqe*)(cq_ptr + p.cq_off.cqes);
+
+        m_tail = *sq_tail;
+    }
+
+    ~uring() {
+        ::munmap(sqes, sqes_size);
+        if (cq_ptr != sq_ptr) ::munmap(cq_ptr, cq_size);
+        ::munmap(sq_ptr, sq_size);
+        ::close(m_fd);
+    }
+
+    int fd() const {
+        return m_fd;
+    }
+
+    //   SQE.    --    .
+    struct io_uring_sqe* get_sqe() {
+
+        while (m_tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE) >= sq_entries)
+            submit(0);
+
+        unsigned idx = m_tail & *sq_mask;
+        sq_array[idx] = idx;
+        ++m_tail;
+
+        struct io_uring_sqe* ret = &sqes[idx];
+        ::memset(ret, 0, sizeof(*ret));
+        return ret;
+    }
+
+    //     SQE     wait_nr .
+    void submit(unsigned wait_nr) {
+
+        __atomic_store_n(sq_tail, m_tail, __ATOMIC_RELEASE);
+
+        unsigned n = m_tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+
+        if (n == 0 && wait_nr == 0)
+            return;
+
+        int tmp = ::syscall(__NR_io_uring_enter, m_fd, n, wait_nr, (wait_nr > 0 ? IORING_ENTER_GETEVENTS : 0), NULL, 0);
+
+        // EBUSY/EAGAIN:   ;     .
+        if (tmp < 0 && errno != EINTR && errno != EBUSY && errno != EAGAIN)
+            throw error::system_error("could not io_uring_enter() : ");
+    }
+
+    struct io_uring_cqe* peek() {
+
+        unsigned head = *cq_head;
+
+        if (head == __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE))
+            return NULL;
+
+        return &cqes[head & *cq_mask];
+    }
+
+    void seen() {
+        __atomic_store_n(cq_head, *cq_head + 1, __ATOMIC_RELEASE);
+    }
+
+    void register_(unsigned op, void* arg, unsigned n) {
+
+        if (::syscall(__NR_io_uring_register, m_fd, op, arg, n) < 0)
+            throw error::system_error("could not io_uring_register() : ");
+    }
+
+
+    //   ,  : multishot accept  recv,  .
+    //    IORING_OP_SEND_ZC --      6.0,   multishot recv.
+
+    static bool probe_() {
+
+        try {
+            uring r(4);
+
+            std::vector<unsigned char> tmp(sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op));
+            struct io_uring_probe* p = (struct io_uring_probe*)&tmp[0];
+
+            r.register_(IORING_REGISTER_PROBE, p, 256);
+
+            if (p->ops_len <= IORING_OP_SEND_ZC)
+                return false;
+
+            return (p->ops[IORING_OP_SEND_ZC].flags & IO_URING_OP_SUPPORTED) &&
+                (p->ops[IORING_OP_ACCEPT].flags & IO_URING_OP_SUPPORTED) &&
+                (p->ops[IORING_OP_RECV].flags & IO_URING_OP_SUPPORTED) &&
+                (p->ops[IORING_OP_SEND].flags & IO_URING_OP_SUPPORTED) &&
+                (p->ops[IORING_OP_WRITE].flags & IO_URING_OP_SUPPORTED);
+
+        } catch (std::exception& e) {
+            return false;
+        }
+    }
+
+    static bool supported() {
+        static bool ret = probe_();
+        return ret;
+    }
+};
+
+
+// : io_uring      (,    ).
+
+inline bool& uring_switch_() {
+    static bool on = true;
+    return on;
+}
+
+inline void set_uring(bool on) {
+    uring_switch_() = on;
+}
+
+inline bool use_uring() {
+    return uring_switch_() && uring::supported();
+}
+
+
+
+//  ,        multishot recv.
+
+class uring_buffers {
+
+    uring& ring;
+    unsigned short group;
+
+    struct io_uring_buf_ring* br;
+    size_t br_size;
+
+    unsigned char* arena;
+    unsigned m_count;
+    unsigned m_size;
+
+    unsigned short tail;
+    unsigned short added;
+
+    uring_buffers(const uring_buffers&);
+    uring_buffers& operator=(const uring_buffers&);
+
+public:
+
+    // count --  .
+    uring_buffers(uring& r, unsigned short g, unsigned count, unsigned size) :
+        ring(r), group(g), m_count(count), m_size(size), tail(0), added(0) {
+
+        br_size = count * sizeof(struct io_uring_buf);
+
+        void* tmp = ::mmap(NULL, br_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+        if (tmp == MAP_FAILED)
+            throw error::system_error("could not mmap() buffer ring : ");
+
+        br = (struct io_uring_buf_ring*)tmp;
+
+        struct io_uring_buf_reg reg;
+        ::memset(&reg, 0, sizeof(reg));
+        reg.ring_addr = (uint64_t)(uintptr_t)br;
+        reg.ring_entries = count;
+        reg.bgid = group;
+
+        try {
+            ring.register_(IORING_REGISTER_PBUF_RING, &reg, 1);
+
+        } catch (...) {
+            ::munmap(br, br_size);
+            throw;
+        }
+
+        arena = new unsigned char[(size_t)count * size];
+
+        for (unsigned i = 0; i < count; ++i)
+            give_back(i);
+
+        commit();
+    }
+
+    ~uring_buffers() {
+
+        struct io_uring_buf_reg reg;
+        ::memset(&reg, 0, sizeof(reg));
+        reg.bgid = group;
+
+        ::syscall(__NR_io_uring_register, ring.fd(), IORING_UNREGISTER_PBUF_RING, &reg, 1);
+        ::munmap(br, br_size);
+        delete [] arena;
+    }
+
+    unsigned short id() const {
+        return group;
+    }
+
+    const unsigned char* data(unsigned short bid) const {
+        return arena + (size_t)bid * m_size;
+    }
+
+    //   .      commit().
+    void give_back(unsigned short bid) {
+
+        //  br->bufs:  C++    __DECLARE_FLEX_ARRAY     .
+        struct io_uring_buf* b = (struct io_uring_buf*)br + ((unsigned short)(tail + added) & (m_count - 1));
+        b->addr = (uint64_t)(uintptr_t)data(bid);
+        b->len = m_size;
+        b->bid = bid;
+        ++added;
+    }
+
+    void commit() {
+
+        if (added == 0)
+            return;
+
+        tail += added;
+        added = 0;
+        __atomic_store_n(&(br->tail), tail, __ATOMIC_RELEASE);
+    }
+};
+
+
+
+class uring_loop;
+
+//    io_uring.        (unknown_socket::backend).
+
+//    (  reap()),       :
+//   -> backend -> buf ->     .
+
+class uring_connection : public io_backend {
+public:
+
+    //      : send()   ( recv()),  
+    //    , --        .
+    static const size_t HIGH_WATER = 1024 * 1024;
+
+    uring_loop& loop;
+    service_buffer buf;
+    int fd;
+
+    //  :    uring_buffers  . in_off --     .
+    std::deque<std::pair<unsigned short, unsigned int> > in;
+    size_t in_off;
+
+    // out , out_flight --  .
+    std::string out;
+    std::string out_flight;
+    size_t flight_off;
+
+    bool sending;
+    bool queued;
+    bool recv_armed;
+    bool eof;
+    bool closing;
+    bool shut;
+    bool ready;
+
+    uring_connection(uring_loop& l, service_buffer b) :
+        loop(l), buf(b), fd(b->m_obj->fd), in_off(0), flight_off(0),
+        sending(false), queued(false), recv_armed(false), eof(false), closing(false), shut(false), ready(false) {}
+
+    size_t take_(void* buff, size_t len);
+
+    size_t pending_() const {
+        return out.size() + out_flight.size() - flight_off;
+    }
+
+    void send(const void* data, size_t len);
+    void sendv(struct iovec* iov, size_t n, bool more);
+    size_t recv(void* buff, size_t len);
+    size_t recv_nowait(void* buff, size_t len);
+};
+
+
+//   :  ,   .   uring_server.
+
+class uring_loop {
+
+    enum {
+        OP_ACCEPT = 1,
+        OP_RECV = 2,
+        OP_SEND = 3
+    };
+
+    static const unsigned ENTRIES = 1024;
+    static const unsigned BUFFERS = 1024;
+    static const unsigned BUFFER_SIZE = 4096;
+
+    server_socket& server;
+    int* conn_count;
+    size_t maxconns;
+
+    std::vector<uring_connection*> writers;
+    std::vector<uring_connection*> rearm;
+    std::vector<uring_connection*> dead;
+
+    //  unknown_socket::backend:   reap(),   .
+    struct no_delete_ {
+        void operator()(io_backend*) const {}
+    };
+
+    static uint64_t tag_(uring_connection* c, int op) {
+        return (uint64_t)(uintptr_t)c | op;
+    }
+
+    void arm_accept() {
+        struct io_uring_sqe* sqe = ring.get_sqe();
+        sqe->opcode = IORING_OP_ACCEPT;
+        sqe->fd = server.fd;
+        sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+        sqe->accept_flags = SOCK_CLOEXEC;
+        sqe->user_data = tag_(NULL, OP_ACCEPT);
+    }
+
+    void arm_recv(uring_connection* c) {
+        struct io_uring_sqe* sqe = ring.get_sqe();
+        sqe->opcode = IORING_OP_RECV;
+        sqe->fd = c->fd;
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = bufs.id();
+        sqe->user_data = tag_(c, OP_RECV);
+        c->recv_armed = true;
+    }
+
+    void arm_send(uring_connection* c) {
+        struct io_uring_sqe* sqe = ring.get_sqe();
+        sqe->opcode = IORING_OP_SEND;
+        sqe->fd = c->fd;
+        sqe->addr = (uint64_t)(uintptr_t)(c->out_flight.data() + c->flight_off);
+        sqe->len = c->out_flight.size() - c->flight_off;
+        sqe->msg_flags = MSG_NOSIGNAL;
+        sqe->user_data = tag_(c, OP_SEND);
+        c->sending = true;
+    }
+
+    void mark_ready(uring_connection* c) {
+        if (!c->ready) {
+            c->ready = true;
+            ready.push_back(c);
+        }
+    }
+
+    //    recv    --  .
+    void try_finish(uring_connection* c) {
+
+        if (!c->closing || c->sending)
+            return;
+
+        if (!c->shut) {
+
+            if (!c->out.empty())
+                return;
+
+            //   multishot recv.
+            ::shutdown(c->fd, SHUT_RDWR);
+            c->shut = true;
+        }
+
+        if (!c->recv_armed)
+            dead.push_back(c);
+    }
+
+    void accepted(int res, bool more) {
+
+        if (!more)
+            arm_accept();
+
+        if (res < 0) {
+            logger::log(logger::ERROR) << "ERROR in serving : could not accept() : errno = " << -res;
+            return;
+        }
+
+        server.count_accepted(res);
+
+        //      (. handoff.h).
+        if (server.handed_off()) {
+
+            try {
+                server.hand_off(res);
+
+            } catch (std::exception& e) {
+                logger::log(logger::ERROR) << "ERROR in handoff : " << e.what();
+            }
+
+            return;
+        }
+
+        if (maxconns > 0 && (size_t)lockfree::atomic_add(conn_count, 0) >= maxconns) {
+            ::shutdown(res, SHUT_RDWR);
+            ::close(res);
+            return;
+        }
+
+        server.setup_client(res);
+
+        //   multishot accept  ; getpeername()   .
+        struct sockaddr_in peer;
+        peer.sin_family = AF_UNSPEC;
+
+        int n = lockfree::atomic_add(conn_count, 1);
+
+        uring_connection* c = new uring_connection(*this, make_connection(res, n, peer));
+        c->buf->m_obj->backend.reset(c, no_delete_());
+        server.watch(c->buf);
+
+        arm_recv(c);
+    }
+
+    void received(uring_connection* c, int res, unsigned flags) {
+
+        if (res > 0) {
+            unsigned short bid = flags >> IORING_CQE_BUFFER_SHIFT;
+
+            if (c->closing)
+                bufs.give_back(bid);
+            else
+                c->in.push_back(std::make_pair(bid, (unsigned int)res));
+
+        } else if (res != -ENOBUFS) {
+            //    .
+            c->eof = true;
+        }
+
+        if (!c->closing)
+            mark_ready(c);
+
+        if (!(flags & IORING_CQE_F_MORE)) {
+            c->recv_armed = false;
+
+            if (c->closing)
+                try_finish(c);
+            else if (!c->eof)
+                rearm.push_back(c);
+        }
+    }
+
+    void sent(uring_connection* c, int res) {
+
+        c->sending = false;
+
+        if (res < 0) {
+            c->eof = true;
+            c->out.clear();
+            c->out_flight.clear();
+            c->flight_off = 0;
+
+            if (!c->closing)
+                mark_ready(c);
+
+        } else {
+            c->flight_off += res;
+
+            if (c->flight_off < c->out_flight.size()) {
+                arm_send(c);
+                return;
+            }
+
+            c->out_flight.clear();
+            c->flight_off = 0;
+
+            if (!c->out.empty())
+                want_send(c);
+        }
+
+        try_finish(c);
+    }
+
+public:
+
+    uring ring;
+    uring_buffers bufs;
+
+    // ,     .
+    std::vector<uring_connection*> ready;
+
+    uring_loop(server_socket& s, int* cc, size_t maxc) :
+        server(s), conn_count(cc), maxconns(maxc), ring(ENTRIES), bufs(ring, 0, BUFFERS, BUFFER_SIZE) {
+
+        arm_accept();
+    }
+
+    void want_send(uring_connection* c) {
+        if (!c->queued) {
+            c->queued = true;
+            writers.push_back(c);
+        }
+    }
+
+    //    ;  block --     .  .
+    void wait(bool block) {
+
+        bufs.commit();
+
+        for (size_t i = 0; i < rearm.size(); ++i) {
+            if (!rearm[i]->closing && !rearm[i]->recv_armed)
+                arm_recv(rearm[i]);
+        }
+
+        rearm.clear();
+
+        for (size_t i = 0; i < writers.size(); ++i) {
+
+            uring_connection* c = writers[i];
+            c->queued = false;
+
+            if (c->sending || c->out.empty())
+                continue;
+
+            c->out_flight.swap(c->out);
+            c->flight_off = 0;
+            arm_send(c);
+        }
+
+        writers.clear();
+
+        ring.submit(block ? 1 : 0);
+
+        struct io_uring_cqe* cqe;
+
+        while ((cqe = ring.peek()) != NULL) {
+
+            uint64_t data = cqe->user_data;
+            int res = cqe->res;
+            unsigned flags = cqe->flags;
+
+            ring.seen();
+
+            uring_connection* c = (uring_connection*)(uintptr_t)(data & ~(uint64_t)7);
+
+            switch (data & 7) {
+            case OP_ACCEPT:
+                accepted(res, flags & IORING_CQE_F_MORE);
+                break;
+
+            case OP_RECV:
+                received(c, res, flags);
+                break;
+
+            case OP_SEND:
+                sent(c, res);
+                break;
+            }
+        }
+    }
+
+    //  : ,  ,  .
+    void close(uring_connection* c) {
+
+        if (c->closing)
+            return;
+
+        // ,      ,   .
+        try {
+            c->buf->send_pending();
+        } catch (...) {}
+
+        c->closing = true;
+
+        while (!c->in.empty()) {
+            bufs.give_back(c->in.front().first);
+            c->in.pop_front();
+        }
+
+        try_finish(c);
+    }
+
+    //  .   :       ready.
+    void reap() {
+
+        for (size_t i = 0; i < dead.size(); ++i) {
+
+            dead[i]->buf->m_obj->backend.reset();
+
+            //    --   ,       .
+            delete dead[i];
+
+            lockfree::atomic_add(conn_count, -1);
+        }
+
+        dead.clear();
+    }
+};
+
+
+inline size_t uring_connection::take_(void* buff, size_t len) {
+
+    size_t ret = 0;
+
+    while (ret < len && !in.empty()) {
+
+        std::pair<unsigned short, unsigned int>& f = in.front();
+
+        size_t n = f.second - in_off;
+        if (n > len - ret) n = len - ret;
+
+        ::memcpy((unsigned char*)buff + ret, loop.bufs.data(f.first) + in_off, n);
+
+        ret += n;
+        in_off += n;
+
+        if (in_off == f.second) {
+            loop.bufs.give_back(f.first);
+            in.pop_front();
+            in_off = 0;
+        }
+    }
+
+    return ret;
+}
+
+inline void uring_connection::send(const void* data, size_t len) {
+
+    const char* p = (const char*)data;
+
+    while (1) {
+
+        if (eof)
+            throw send_error("could not send() : connection closed");
+
+        size_t n = (pending_() < HIGH_WATER ? HIGH_WATER - pending_() : 0);
+        if (n > len) n = len;
+
+        out.append(p, n);
+        p += n;
+        len -= n;
+
+        loop.want_send(this);
+
+        if (len == 0)
+            return;
+
+        loop.wait(true);
+    }
+}
+
+// more  :         .
+inline void uring_connection::sendv(struct iovec* iov, size_t n, bool) {
+
+    for (size_t i = 0; i < n; ++i)
+        send(iov[i].iov_base, iov[i].iov_len);
+}
+
+//    :  ,    .  
+//        ,   , 
+//   .      (server_socket::set_timeouts()):
+//     ,  recv()   .
+inline size_t uring_connection::recv(void* buff, size_t len) {
+
+    while (in.empty()) {
+
+        if (eof)
+            throw eof_exception();
+
+        loop.wait(true);
+    }
+
+    return take_(buff, len);
+}
+
+inline size_t uring_connection::recv_nowait(void* buff, size_t len) {
+
+    if (in.empty()) {
+
+        if (eof)
+            throw eof_exception();
+
+        return 0;
+    }
+
+    return take_(buff, len);
+}
+
+
+
+//  ,  evented_server (. evented.h),   io_uring.   --  .
+
+template <typename F, typename P>
+class uring_server {
+
+    server_socket& server;
+    F service;
+    P complete;
+
+    unsigned int nloops;
+
+    int conn_count;
+    size_t maxconns;
+
+    //  false,    .
+    bool handle(uring_connection* c) {
+
+        buffer<service_socket>& b = *(c->buf);
+
+        while (1) {
+
+            b.fill_available();
+
+            while (complete(b) || b.full()) {
+
+                size_t scanned = b.bytes_scanned();
+                size_t avail = b.available();
+
+                if (!service(c->buf))
+                    return false;
+
+                if (b.available() == 0)
+                    break;
+
+                //     (. evented.h).
+                if (b.bytes_scanned() == scanned && b.available() == avail) {
+
+                    if (b.full()) {
+                        logger::log(logger::ERROR) << "WARNING: handler consumed nothing from a full buffer, closing";
+                        return false;
+                    }
+
+                    break;
+                }
+            }
+
+            //      --  .
+            if (c->in.empty() || b.full())
+                break;
+        }
+
+        if (c->eof && c->in.empty() && b.available() == 0)
+            return false;
+
+        //   --   ,  --  .
+        if (b.available() > 0)
+            b.m_obj->timer.reading();
+        else
+            b.m_obj->timer.idle();
+
+        //      .
+        b.release();
+        return true;
+    }
+
+    void loop() {
+
+        uring_loop l(server, &conn_count, maxconns);
+
+        while (1) {
+
+            try {
+                l.wait(true);
+
+            } catch (std::exception& e) {
+                logger::log(logger::ERROR) << "ERROR in io_uring : " << e.what();
+                continue;
+            }
+
+            for (size_t i = 0; i < l.ready.size(); ++i) {
+
+                uring_connection* c = l.ready[i];
+                c->ready = false;
+
+                if (c->closing)
+                    continue;
+
+                bool keep = false;
+
+                try {
+                    keep = handle(c);
+
+                } catch (eof_exception& e) {
+                    keep = false;
+
+                } catch (std::exception& e) {
+                    logger::log(logger::ERROR) << "ERROR in uring serving : " << e.what();
+                    keep = false;
+
+                } catch (...) {
+                    logger::log(logger::ERROR) << "UNKNOWN ERROR in uring serving";
+                    keep = false;
+                }
+
+                if (!keep)
+                    l.close(c);
+            }
+
+            l.ready.clear();
+            l.reap();
+        }
+    }
+
+    //   ,  use_uring()  (,     ), --
+    //     epoll,        .
+    // maxconns   .
+    void run_loop() {
+
+        try {
+            loop();
+
+        } catch (std::exception& e) {
+            logger::log(logger::ERROR) << "ERROR in io_uring loop : " << e.what();
+
+        } catch (...) {
+            logger::log(logger::ERROR) << "UNKNOWN ERROR in io_uring loop";
+        }
+
+        logger::log(logger::ERROR) << "WARNING: io_uring loop is down, falling back to epoll.";
+        serve_evented_blocking(server, service, 1, maxconns, complete);
+    }
+
+public:
+
+    uring_server(server_socket& s, F f, P p, unsigned int n, size_t maxc) :
+        server(s), service(f), complete(p), nloops(n), conn_count(0), maxconns(maxc) {
+
+        if (nloops == 0) nloops = 1;
+    }
+
+    size_t connections() {
+        return lockfree::atomic_add(&conn_count, 0);
+    }
+
+    void serve() {
+
+        for (unsigned int i = 1; i < nloops; ++i) {
+            boost::thread(boost::bind(&uring_server::run_loop, this));
+        }
+
+        run_loop();
+    }
+};
+
+
+//   io_uring   --  serve_evented_blocking().
+
+template <typename F, typename P>
+inline void serve_uring_blocking(server_socket& server, F service, unsigned int nloops, size_t maxconns, P complete) {
+
+    if (!use_uring()) {
+        logger::log(logger::ERROR) << "WARNING: io_uring is not available, falling back to epoll.";
+        serve_evented_blocking(server, service, nloops, maxconns, complete);
+        return;
+    }
+
+    uring_server<F,P> us(server, service, complete, nloops, maxconns);
+    us.serve();
+}
+
+template <typename F>
+inline void serve_uring_blocking(server_socket& server, F service, unsigned int nloops = 1, size_t maxconns = 0) {
+    serve_uring_blocking(server, service, nloops, maxconns, head_complete());
+}
+
+template <typename F, typename P>
+inline void serve_uring(server_socket& server, F service, unsigned int nloops, size_t maxconns, P complete) {
+
+    boost::thread th(boost::bind<void>(&serve_uring_blocking<F,P>,
+                                       boost::ref(server), service, nloops, maxconns, complete));
+}
+
+template <typename F>
+inline void serve_uring(server_socket& server, F service, unsigned int nloops = 1, size_t maxconns = 0) {
+    serve_uring(server, service, nloops, maxconns, head_complete());
+}
+
+
+
+//      io_uring:     ,  .
+//       (  ).
+
+class uring_file : public io_backend {
+
+    int fd;
+    size_t batch;
+
+    uring ring;
+
+    std::string m_fill;
+    std::string m_flight;
+    size_t flight_off;
+    bool inflight;
+
+    void write_() {
+        struct io_uring_sqe* sqe = ring.get_sqe();
+        sqe->opcode = IORING_OP_WRITE;
+        sqe->fd = fd;
+        sqe->addr = (uint64_t)(uintptr_t)(m_flight.data() + flight_off);
+        sqe->len = m_flight.size() - flight_off;
+        sqe->off = (uint64_t)-1;
+
+        ring.submit(0);
+        inflight = true;
+    }
+
+    //  ,   .
+    void complete_() {
+
+        while (inflight) {
+
+            struct io_uring_cqe* cqe = ring.peek();
+
+            if (cqe == NULL) {
+                ring.submit(1);
+                continue;
+            }
+
+            int res = cqe->res;
+            ring.seen();
+            inflight = false;
+
+            if (res < 0) {
+                m_flight.clear();
+                errno = -res;
+                throw error::system_error("could not write() : ");
+            }
+
+            flight_off += res;
+
+            if (res > 0 && flight_off < m_flight.size())
+                write_();
+            else
+                m_flight.clear();
+        }
+    }
+
+    void start_() {
+
+        complete_();
+
+        if (m_fill.empty())
+            return;
+
+        m_flight.swap(m_fill);
+        flight_off = 0;
+        write_();
+    }
+
+public:
+
+    uring_file(int f, size_t b) : fd(f), batch(b), ring(4), flight_off(0), inflight(false) {
+        m_fill.reserve(batch);
+    }
+
+    ~uring_file() {
+        try {
+            sync();
+        } catch (std::exception& e) {
+            logger::log(logger::ERROR) << "ERROR in uring_file : " << e.what();
+        }
+    }
+
+    //  ,  .
+    void sync() {
+        start_();
+        complete_();
+    }
+
+    void send(const void* data, size_t len) {
+
+        m_fill.append((const char*)data, len);
+
+        if (m_fill.size() >= batch)
+            start_();
+    }
+
+    void sendv(struct iovec* iov, size_t n, bool) {
+
+        for (size_t i = 0; i < n; ++i)
+            m_fill.append((const char*)iov[i].iov_base, iov[i].iov_len);
+
+        if (m_fill.size() >= batch)
+            start_();
+    }
+
+    size_t recv(void* buff, size_t len) {
+
+        sync();
+
+        ssize_t tmp = ::read(fd, buff, len);
+
+        if (tmp < 0)
+            throw error::system_error("could not read() : ");
+
+        if (tmp == 0)
+            throw eof_exception();
+
+        return tmp;
+    }
+
+    size_t recv_nowait(void* buff, size_t len) {
+        return recv(buff, len);
+    }
+};
+
+
+//       io_uring.     --   .
+
+inline void attach_uring(files::file& f, size_t batch = 256*1024) {
+
+    if (!use_uring())
+        return;
+
+    f->m_obj->backend.reset(new uring_file(f->m_obj->fd, batch));
+}
+
+}
+
+/*
+
+    :
+
+     bool service(service_buffer sock) {
+        ...   //   serve_evented()
+     }
+
+     server_socket server("0.0.0.0", 9876);
+     serve_uring(server, service, 4, 10000, httpd::request_head_complete());
+
+     //  io_uring, ,  ;  serve_uring() --  serve_evented().
+     set_uring(false);
+
+     :
+
+     files::file f = files::open("/var/log/app/access.log");
+     attach_uring(f);
+     f << ...;
+
+ */
+
+
+#endif
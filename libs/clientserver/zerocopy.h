@@ -0,0 +1,219 @@
+#ifndef __CLIENTSERVER_ZEROCOPY_H
+#define __CLIENTSERVER_ZEROCOPY_H
+
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/sendfile.h>
+
+#include <algorithm>
+
+#include "clientserver.h"
+#include "files/files_base.h"
+
+
+namespace clientserver {
+
+
+/*
+ *      userspace.
+ *
+ *  -> : sendfile().  -> : splice()  pipe.
+ *   ,   ;  len --  .
+ *
+ *    (unknown_socket), EAGAIN ,    send()/recv():
+ *      deadline,  --  SO_SNDTIMEO/SO_RCVTIMEO.
+ */
+
+
+namespace {
+
+inline bool retry_(unknown_socket* s, short events) {
+    return (s != NULL ? s->retry(events) : errno == EINTR);
+}
+
+}
+
+
+inline size_t send_file(int sock, int file, off_t offset, size_t len, unknown_socket* s = NULL) {
+
+    size_t done = 0;
+
+    while (done < len) {
+
+        ssize_t tmp = ::sendfile(sock, file, &offset, len - done);
+
+        if (tmp < 0) {
+            if (retry_(s, POLLOUT))
+                continue;
+
+            throw send_error("could not sendfile() : " + error::strerror());
+        }
+
+        if (tmp == 0)
+            break;
+
+        done += tmp;
+    }
+
+    return done;
+}
+
+
+namespace {
+
+struct pipe_ {
+    int fd[2];
+
+    pipe_() {
+        if (::pipe2(fd, O_CLOEXEC) < 0)
+            throw error::system_error("could not pipe2() : ");
+    }
+
+    ~pipe_() {
+        ::close(fd[0]);
+        ::close(fd[1]);
+    }
+};
+
+}
+
+
+inline size_t splice_sockets(int to, int from, size_t len, unknown_socket* ts = NULL, unknown_socket* fs = NULL) {
+
+    pipe_ p;
+    size_t done = 0;
+
+    while (done < len) {
+
+        ssize_t in = ::splice(from, NULL, p.fd[1], NULL, len - done, SPLICE_F_MOVE | SPLICE_F_MORE);
+
+        if (in < 0) {
+            if (retry_(fs, POLLIN))
+                continue;
+
+            throw recv_error("could not splice() : " + error::strerror());
+        }
+
+        if (in == 0)
+            break;
+
+        // ,    pipe,   .
+        while (in > 0) {
+
+            ssize_t out = ::splice(p.fd[0], NULL, to, NULL, in,
+                                   SPLICE_F_MOVE | (done + in < len ? SPLICE_F_MORE : 0));
+
+            if (out < 0) {
+                if (retry_(ts, POLLOUT))
+                    continue;
+
+                throw send_error("could not splice() : " + error::strerror());
+            }
+
+            in -= out;
+            done += out;
+        }
+    }
+
+    return done;
+}
+
+
+
+//    .     ,  MSG_MORE,
+//          .
+//
+//     (buffer::defer_writes())     : 
+//     ,    .
+
+template <typename T>
+inline size_t send_file(boost::shared_ptr<buffer<T> >& sock, files::file& f, off_t offset, size_t len) {
+
+    if (sock->deferred()) {
+
+        size_t done = 0;
+
+        while (done < len) {
+
+            std::string tmp(std::min(len - done, (size_t)buffer<T>::BUFF_SIZE), '\0');
+            ssize_t n = ::pread(f->m_obj->fd, &tmp[0], tmp.size(), offset + done);
+
+            if (n < 0) {
+                if (errno == EINTR)
+                    continue;
+
+                throw error::system_error("could not pread() : ");
+            }
+
+            if (n == 0)
+                break;
+
+            tmp.resize(n);
+            sock->take(tmp);
+            done += n;
+        }
+
+        return done;
+    }
+
+    sock->send_pending(len > 0);
+    return send_file(sock->m_obj->fd, f->m_obj->fd, offset, len, sock->m_obj.get());
+}
+
+//        send(),  -- splice().
+
+template <typename T, typename S>
+inline size_t splice_sockets(boost::shared_ptr<buffer<T> >& to, boost::shared_ptr<buffer<S> >& from, size_t len) {
+
+    std::pair<const unsigned char*, size_t> head = from->peek();
+
+    if (head.second > len)
+        head.second = len;
+
+    if (to->deferred()) {
+
+        size_t done = 0;
+
+        try {
+            while (done < len) {
+                std::pair<const unsigned char*, size_t> p = from->read_some(len - done);
+                std::string tmp((const char*)p.first, p.second);
+                to->take(tmp);
+                done += p.second;
+            }
+
+        } catch (eof_exception& e) {
+        }
+
+        return done;
+    }
+
+    to->send_pending(len > 0);
+
+    if (head.second > 0) {
+        to->m_obj->send(head.first, head.second);
+        from->consume(head.second);
+    }
+
+    return head.second + splice_sockets(to->m_obj->fd, from->m_obj->fd, len - head.second,
+                                        to->m_obj.get(), from->m_obj.get());
+}
+
+}
+
+/*
+
+    :
+
+     files::file f = files::open("/data/blob", false, true);
+     struct stat st;
+     ::fstat(f->m_obj->fd, &st);
+
+     httpd::responder resp(sock, req);
+     resp.send_file(f, 0, st.st_size);
+
+ */
+
+
+#endif
@@ -22,20 +22,62 @@ class file_ {
 public:
     int fd;
 
+    //   --       (. clientserver/uring.h).
+    boost::shared_ptr<clientserver::io_backend> backend;
+
     file_(int f) : fd(f) {}
     
     ~file_() {
+        //   ,  backend    .
+        backend.reset();
 	::close(fd);
     }
 
     void send(const void* data, size_t len) {
+
+        if (backend) {
+            backend->send(data, len);
+            return;
+        }
+
 	ssize_t tmp = ::write(fd, data, len);
 
 	if (tmp < 0 || tmp != (ssize_t)len)
 	    throw error::system_error("could not write() : ");
     }
 
+    void sendv(struct iovec* iov, size_t n, bool more) {
+
+        if (backend) {
+            backend->sendv(iov, n, more);
+            return;
+        }
+
+        while (n > 0) {
+
+            ssize_t tmp = ::writev(fd, iov, n);
+
+            if (tmp < 0)
+                throw error::system_error("could not writev() : ");
+
+            while (n > 0 && (size_t)tmp >= iov->iov_len) {
+                tmp -= iov->iov_len;
+                ++iov;
+                --n;
+            }
+
+            if (n > 0) {
+                iov->iov_base = (char*)iov->iov_base + tmp;
+                iov->iov_len -= tmp;
+            }
+        }
+    }
+
     size_t recv(void* buff, size_t len) {
+
+        if (backend)
+            return backend->recv(buff, len);
+
 	int tmp = 0;
 	tmp = ::read(fd, buff, len);
 
@@ -186,7 +186,7 @@ bool _strchr(const char* s, int l, char c) {
  */
 
 template <typename B,typename T> 
-inline void scan_numeric(B buf, T& t, unsigned char& la, const char* terminator, int tlen, int base = 10) {
+inline void scan_numeric(B& buf, T& t, unsigned char& la, const char* terminator, int tlen, int base = 10) {
 
     /*  . */
     bool neg = false;
@@ -225,7 +225,7 @@ inline void scan_numeric(B buf, T& t, unsigned char& la, const char* terminator,
 // HACK.
 
 template <typename B,typename T,typename F>
-inline void scan_real(B buf, T& t, unsigned char& la, const char* terminator, int tlen, F f) {
+inline void scan_real(B& buf, T& t, unsigned char& la, const char* terminator, int tlen, F f) {
     char buff[256];
     int i = 0;
 
@@ -253,7 +253,7 @@ inline void scan_real(B buf, T& t, unsigned char& la, const char* terminator, in
 
 
 template <typename B,typename T>
-inline void scan_string(B buf, T& t, size_t size) {
+inline void scan_string(B& buf, T& t, size_t size) {
     // - .
     t.clear();
 
@@ -269,7 +269,7 @@ inline void scan_string(B buf, T& t, size_t size) {
 
 
 template <typename B,typename T>
-inline void scan_string_2(B buf, T& t, size_t size) {
+inline void scan_string_2(B& buf, T& t, size_t size) {
 
     unsigned char tmp;
     t.clear();
@@ -281,7 +281,7 @@ inline void scan_string_2(B buf, T& t, size_t size) {
 }
 
 template <typename B,typename T>
-inline void scan_string_3(B buf, T& t, unsigned char& la, const char* terminator, int tlen) {
+inline void scan_string_3(B& buf, T& t, unsigned char& la, const char* terminator, int tlen) {
 
     t.clear();
 
@@ -295,6 +295,39 @@ inline void scan_string_3(B buf, T& t, unsigned char& la, const char* terminator
 }
 
 
+//  ( ) :   ,     .
+
+template <typename B,typename T> 
+inline void scan_numeric(const B& buf, T& t, unsigned char& la, const char* terminator, int tlen, int base = 10) {
+    B tmp(buf);
+    scan_numeric(tmp, t, la, terminator, tlen, base);
+}
+
+template <typename B,typename T,typename F>
+inline void scan_real(const B& buf, T& t, unsigned char& la, const char* terminator, int tlen, F f) {
+    B tmp(buf);
+    scan_real(tmp, t, la, terminator, tlen, f);
+}
+
+template <typename B,typename T>
+inline void scan_string(const B& buf, T& t, size_t size) {
+    B tmp(buf);
+    scan_string(tmp, t, size);
+}
+
+template <typename B,typename T>
+inline void scan_string_2(const B& buf, T& t, size_t size) {
+    B tmp(buf);
+    scan_string_2(tmp, t, size);
+}
+
+template <typename B,typename T>
+inline void scan_string_3(const B& buf, T& t, unsigned char& la, const char* terminator, int tlen) {
+    B tmp(buf);
+    scan_string_3(tmp, t, la, terminator, tlen);
+}
+
+
 
 /*
  *
@@ -28,9 +28,17 @@ template <typename T, typename B> struct load_;
 
 /******    . ***/
 
+//      (B&),    shared_ptr   .
 template <typename T, typename B>
-inline void load(B buf, T& t) {
-    load_<T,B>()(buf, t);
+inline void load(B& buf, T& t) {
+    load_<T,B&>()(buf, t);
+}
+
+//  ( ) :   ,     .
+template <typename T, typename B>
+inline void load(const B& buf, T& t) {
+    B tmp(buf);
+    load(tmp, t);
 }
 
 
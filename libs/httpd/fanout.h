@@ -0,0 +1,467 @@
+#ifndef __HTTPD_FANOUT_H
+#define __HTTPD_FANOUT_H
+
+
+#include <sys/epoll.h>
+
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "http-client.h"
+
+
+namespace httpd {
+
+
+/*
+ *    .
+ *
+ *    ,     (http1_1);  ,
+ *     --    epoll,   ,  
+ *   --     ,   ,    
+ *  .      ,   ;
+ *     . ,    , 
+ *  .
+ */
+
+
+enum shard_status {
+    SHARD_PENDING,
+    SHARD_OK,
+    SHARD_TIMEOUT,
+    SHARD_ERROR
+};
+
+template <typename T>
+struct shard_reply {
+    shard_status status;
+    std::string error;
+
+    std::string head;
+    client::fields_t fields;
+    T data;
+
+    //  ,     fan_out().
+    unsigned long long usec;
+
+    shard_reply() : status(SHARD_PENDING), usec(0) {}
+};
+
+typedef std::vector<std::pair<address, request> > shard_requests;
+
+
+namespace detail {
+
+//   --  ,       buffer<T>.
+struct received_ {
+
+    const char* data;
+    size_t size;
+    size_t pos;
+
+    received_(const char* d, size_t s) : data(d), size(s), pos(0) {}
+
+    size_t recv(void* buff, size_t len) {
+
+        if (pos >= size)
+            throw clientserver::eof_exception();
+
+        size_t n = std::min(len, size - pos);
+        ::memcpy(buff, data + pos, n);
+        pos += n;
+        return n;
+    }
+
+    size_t recv_nowait(void* buff, size_t len) {
+        return (pos >= size ? 0 : recv(buff, len));
+    }
+
+    void send(const void*, size_t) {
+        throw clientserver::send_error("could not send() : read-only");
+    }
+
+    void sendv(struct iovec*, size_t, bool) {
+        throw clientserver::send_error("could not send() : read-only");
+    }
+};
+
+typedef boost::shared_ptr<clientserver::buffer<received_> > received_buffer_;
+
+inline received_buffer_ received_buffer_of_(const char* data, size_t size) {
+    return received_buffer_(new clientserver::buffer<received_>(boost::shared_ptr<received_>(new received_(data, size))));
+}
+
+
+//   : , , .
+//
+//   ,     :     
+// ,      ,      
+//  ,   .
+struct reply_state {
+
+    //    connect().
+    bool connecting;
+
+    //       .
+    std::string out;
+    size_t sent;
+
+    std::string in;
+
+    //    .
+    size_t scanned;
+
+    //  ; 0 --     .
+    size_t body;
+
+    // Content-Length; -1 --  .
+    long long length;
+
+    reply_state() : connecting(false), sent(0), scanned(0), body(0), length(-1) {}
+};
+
+//   ( )  s   from:    0.
+inline size_t head_end_(const std::string& s, size_t from) {
+
+    const char* b = s.data();
+    const char* e = b + s.size();
+    const char* i = b + from;
+
+    while (i != e) {
+
+        i = (const char*)::memchr(i, '\n', e - i);
+
+        if (i == NULL) return 0;
+
+        ++i;
+
+        if (i != e && *i == '\r') ++i;
+        if (i != e && *i == '\n') return i + 1 - b;
+    }
+
+    return 0;
+}
+
+// true --   ; used --    .   -- .
+template <typename T>
+inline bool parse_reply_(reply_state& st, shard_reply<T>& out, size_t& used) {
+
+    if (st.body == 0) {
+
+        //   : "\n\r\n"   .
+        st.body = head_end_(st.in, st.scanned > 2 ? st.scanned - 2 : 0);
+
+        if (st.body == 0) {
+            st.scanned = st.in.size();
+            return false;
+        }
+
+        received_buffer_ b = received_buffer_of_(st.in.data(), st.body);
+
+        std::string line;
+        b->read_until('\n', line);
+
+        out.head.clear();
+
+        for (std::string::const_iterator i = line.begin(); i != line.end(); ++i) {
+            if (*i == '\r' || *i == '\n') continue;
+
+            out.head += *i;
+        }
+
+        request tmp;
+        parse_request_fields(b, tmp);
+        out.fields.swap(tmp.fields);
+
+        client::check_reply_head(out.head);
+
+        client::fields_t::const_iterator i = out.fields.find("content-length");
+
+        if (i != out.fields.end() && i->second.size() > 0)
+            st.length = ::atoll(i->second.front().c_str());
+    }
+
+    size_t have = st.in.size() - st.body;
+
+    //   --       .
+    if (st.length >= 0) {
+
+        if (have < (unsigned long long)st.length)
+            return false;
+
+        received_buffer_ b = received_buffer_of_(st.in.data() + st.body, st.length);
+
+        try {
+            serialization::load(b, out.data);
+
+        } catch (clientserver::eof_exception& e) {
+            throw std::runtime_error("reply body is shorter than its Content-Length");
+        }
+
+        used = st.body + st.length;
+        return true;
+    }
+
+    //  Content-Length       :    .
+    received_buffer_ b = received_buffer_of_(st.in.data() + st.body, have);
+
+    try {
+        serialization::load(b, out.data);
+
+    } catch (clientserver::eof_exception& e) {
+        return false;
+    }
+
+    used = st.body + b->bytes_scanned();
+    return true;
+}
+
+//  :      connect().   : 
+//     epoll   tag (. step_()).
+template <typename POOL>
+inline void start_request_(POOL& pool, const address& addr, const request& req,
+                           typename POOL::client& conn, reply_state& st, int ep, size_t tag) {
+
+    unparse_request(req, st.out);
+    st.sent = 0;
+
+    conn = pool.get_pooled(addr);
+    st.connecting = !conn;
+
+    if (st.connecting)
+        conn = pool.attach(addr, clientserver::connect_nowait(addr.host, addr.port, pool.rcv_timeout, pool.snd_timeout));
+
+    //   :  ,     .
+    struct epoll_event ev;
+    ev.events = EPOLLOUT;
+    ev.data.u64 = tag;
+
+    if (::epoll_ctl(ep, EPOLL_CTL_ADD, conn.m_sock->m_obj->fd, &ev) < 0)
+        throw error::system_error("could not epoll_ctl() : ");
+}
+
+// ,  ,    . true --  ; 
+// reusable --      .     -- .
+template <typename C, typename T>
+inline bool read_reply_(C& conn, reply_state& st, shard_reply<T>& out, std::vector<unsigned char>& tmp, bool& reusable) {
+
+    std::string& in = st.in;
+
+    // -        .
+    std::pair<const unsigned char*, size_t> left = conn.m_sock->peek();
+
+    if (left.second > 0) {
+        in.append((const char*)left.first, left.second);
+        conn.m_sock->consume(left.second);
+    }
+
+    bool eof = false;
+
+    try {
+        size_t got;
+
+        while ((got = conn.m_sock->m_obj->recv_nowait(&tmp[0], tmp.size())) > 0)
+            in.append((const char*)&tmp[0], got);
+
+    } catch (clientserver::eof_exception& e) {
+        eof = true;
+    }
+
+    size_t used = 0;
+
+    if (parse_reply_(st, out, used)) {
+
+        //      --    .
+        reusable = (!eof && used == in.size());
+        return true;
+    }
+
+    if (eof)
+        throw std::runtime_error("connection closed before the reply was complete");
+
+    return false;
+}
+
+//  epoll  :  --  ,  ; 
+//  --     (. read_reply_()).  -- .
+template <typename C, typename T>
+inline bool step_(C& conn, reply_state& st, shard_reply<T>& out, std::vector<unsigned char>& tmp,
+                  bool& reusable, int ep, size_t tag) {
+
+    clientserver::client_socket& s = *(conn.m_sock->m_obj);
+
+    if (st.connecting) {
+
+        int err = clientserver::connect_finish(s.fd);
+
+        if (err != 0) {
+            throw clientserver::connection_error("could not connect() (" + conn.m_host + ":" + files::format(conn.m_port)
+                                                 + ") : errno = " + files::format(err));
+        }
+
+        st.connecting = false;
+    }
+
+    if (st.sent < st.out.size()) {
+
+        st.sent += s.send_nowait(st.out.data() + st.sent, st.out.size() - st.sent);
+
+        if (st.sent < st.out.size())
+            return false;
+
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.u64 = tag;
+
+        if (::epoll_ctl(ep, EPOLL_CTL_MOD, s.fd, &ev) < 0)
+            throw error::system_error("could not epoll_ctl() : ");
+
+        return false;
+    }
+
+    return read_reply_(conn, st, out, tmp, reusable);
+}
+
+//   :   epoll      .
+template <typename POOL>
+inline void finish_request_(POOL& pool, const address& addr, typename POOL::client& conn, int ep,
+                            const client::fields_t& fields, bool reusable) {
+
+    ::epoll_ctl(ep, EPOLL_CTL_DEL, conn.m_sock->m_obj->fd, NULL);
+
+    if (reusable)
+        pool.put(addr, conn, fields);
+
+    conn = typename POOL::client();
+}
+
+}
+
+
+//  reqs   pool (http1_1<...>),  --  T,  
+// serialized_client::send_get_serialized(). timeout --    .
+//   ,  .
+
+template <typename T, typename POOL>
+inline size_t fan_out(POOL& pool, const shard_requests& reqs, std::vector<shard_reply<T> >& out, unsigned int timeout) {
+
+    typedef typename POOL::client client_t;
+
+    unsigned long long start = clientserver::monotonic_usec();
+    unsigned long long deadline = start + timeout * 1000ULL;
+
+    out.clear();
+    out.resize(reqs.size());
+
+    std::vector<client_t> conns(reqs.size());
+    std::vector<detail::reply_state> in(reqs.size());
+
+    int ep = ::epoll_create1(EPOLL_CLOEXEC);
+
+    if (ep < 0)
+        throw error::system_error("could not epoll_create1() : ");
+
+    struct closer {
+        int fd;
+        closer(int f) : fd(f) {}
+        ~closer() { ::close(fd); }
+    } c(ep);
+
+    size_t pending = 0;
+    size_t ok = 0;
+
+    for (size_t i = 0; i < reqs.size(); ++i) {
+
+        try {
+            detail::start_request_(pool, reqs[i].first, reqs[i].second, conns[i], in[i], ep, i);
+            ++pending;
+
+        } catch (std::exception& e) {
+            out[i].status = SHARD_ERROR;
+            out[i].error = e.what();
+            conns[i] = client_t();
+        }
+    }
+
+    std::vector<struct epoll_event> events(pending > 0 ? pending : 1);
+    std::vector<unsigned char> tmp(clientserver::buffer<clientserver::client_socket>::BUFF_SIZE);
+
+    while (pending > 0) {
+
+        unsigned long long now = clientserver::monotonic_usec();
+
+        if (now >= deadline)
+            break;
+
+        int n = ::epoll_wait(ep, &events[0], events.size(), (deadline - now + 999) / 1000);
+
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+
+            throw error::system_error("could not epoll_wait() : ");
+        }
+
+        for (int j = 0; j < n; ++j) {
+
+            size_t i = events[j].data.u64;
+
+            bool reusable = false;
+
+            try {
+
+                if (!detail::step_(conns[i], in[i], out[i], tmp, reusable, ep, i))
+                    continue;
+
+                out[i].status = SHARD_OK;
+                out[i].usec = clientserver::monotonic_usec() - start;
+                ++ok;
+
+            } catch (std::exception& e) {
+                out[i].status = SHARD_ERROR;
+                out[i].error = e.what();
+            }
+
+            detail::finish_request_(pool, reqs[i].first, conns[i], ep, out[i].fields, reusable);
+            --pending;
+        }
+    }
+
+    //   -- : ,  ,    .
+    for (size_t i = 0; i < out.size(); ++i) {
+
+        if (out[i].status == SHARD_PENDING) {
+            out[i].status = SHARD_TIMEOUT;
+            out[i].error = "deadline exceeded";
+        }
+    }
+
+    return ok;
+}
+
+}
+
+/*
+
+    :
+
+     static httpd::http1_1<httpd::serialized_client> pool(1000, 1000, 100);
+
+     httpd::shard_requests reqs;
+
+     for (size_t i = 0; i < shards.size(); ++i)
+         reqs.push_back(std::make_pair(shards[i], req));
+
+     std::vector<httpd::shard_reply<result> > replies;
+     size_t ok = httpd::fan_out(pool, reqs, replies, 50);
+
+     for (size_t i = 0; i < replies.size(); ++i) {
+         if (replies[i].status == httpd::SHARD_OK)
+             merge(replies[i].data);
+     }
+
+ */
+
+
+#endif
@@ -0,0 +1,303 @@
+#ifndef __HTTPD_HEDGE_H
+#define __HTTPD_HEDGE_H
+
+
+#include "fanout.h"
+#include "metrics/metrics.h"
+#include "lockfree/aux_.h"
+
+
+namespace httpd {
+
+
+/*
+ *   (hedging).
+ *
+ *    ;      delay(),   
+ *  ,    . delay() --  
+ *  ,     .   
+ *  ,       .
+ *
+ *    :      .
+ */
+
+class hedging {
+
+    //   ,      max_delay.
+    static const unsigned long MIN_SAMPLES = 100;
+
+    //     :   ;  WINDOW , 
+    //  ,      .  -- 
+    // , ..   WINDOW..2*WINDOW : ,   
+    //  ,   .
+    static const unsigned long WINDOW = 1000;
+
+    metrics::histogram windows[2];
+    unsigned int current;
+
+    double pct;
+    double budget;
+    unsigned int min_delay;
+    unsigned int max_delay;
+
+    unsigned long requests;
+    unsigned long hedges;
+    unsigned int rr;
+
+public:
+
+    metrics::counter& hedged;
+    metrics::counter& won;
+    metrics::counter& denied;
+
+    // p --   (, 95); b --   
+    //   (, 0.05).  --  .
+    hedging(double p = 95, double b = 0.05, unsigned int mind = 1, unsigned int maxd = 1000) :
+        current(0), pct(p), budget(b), min_delay(mind), max_delay(maxd), requests(0), hedges(0), rr(0),
+        hedged(metrics::get_counter("httpd_hedged_total", "Hedge requests sent.")),
+        won(metrics::get_counter("httpd_hedge_wins_total", "Hedge requests that answered first.")),
+        denied(metrics::get_counter("httpd_hedge_denied_total", "Hedge requests not sent because the budget was spent.")) {}
+
+    //    ,  .
+    unsigned int delay() {
+
+        unsigned int c = lockfree::atomic_add(&current, 0U);
+        metrics::histogram& now = windows[c % 2];
+        metrics::histogram& prev = windows[(c + 1) % 2];
+
+        if (now.count() + prev.count() < MIN_SAMPLES)
+            return max_delay;
+
+        unsigned int ret = (now.percentile(pct, &prev) + 999) / 1000;
+
+        if (ret < min_delay) ret = min_delay;
+        if (ret > max_delay) ret = max_delay;
+
+        return ret;
+    }
+
+    void observe(unsigned long long usec) {
+
+        unsigned int c = lockfree::atomic_add(&current, 0U);
+        windows[c % 2].observe(usec);
+
+        //      -- ,  cas .
+        if (windows[c % 2].count() >= WINDOW && lockfree::cas(&current, c, c + 1))
+            windows[(c + 1) % 2].reset();
+    }
+
+    //  ;    .
+    size_t start(size_t replicas) {
+        lockfree::atomic_add(&requests, 1UL);
+        return lockfree::atomic_add(&rr, 1U) % replicas;
+    }
+
+    //      .   --  
+    //      .
+    bool take() {
+
+        unsigned long r = lockfree::atomic_add(&requests, 0UL);
+        unsigned long h = lockfree::atomic_add(&hedges, 1UL);
+
+        if (h > budget * r + 10) {
+            lockfree::atomic_add(&hedges, -1UL);
+            denied.add();
+            return false;
+        }
+
+        hedged.add();
+        return true;
+    }
+};
+
+
+//  req     replicas   pool,   
+// .  --  T,   serialized_client::send_get_serialized().
+// timeout --  ,  .    --  out.
+//
+//     ,      ,
+//   (    --    ).
+
+template <typename T, typename POOL>
+inline shard_status hedged_get(POOL& pool, hedging& h, const addresslist& replicas, const request& req,
+                               shard_reply<T>& out, unsigned int timeout) {
+
+    typedef typename POOL::client client_t;
+
+    out = shard_reply<T>();
+
+    if (replicas.empty()) {
+        out.status = SHARD_ERROR;
+        out.error = "no replicas";
+        return out.status;
+    }
+
+    unsigned long long start = clientserver::monotonic_usec();
+    unsigned long long deadline = start + timeout * 1000ULL;
+    unsigned long long hedge_at = start + h.delay() * 1000ULL;
+
+    size_t first = h.start(replicas.size());
+
+    //    :    .
+    client_t conns[2];
+    detail::reply_state in[2];
+    shard_reply<T> replies[2];
+    size_t target[2];
+    unsigned long long sent[2];
+
+    size_t started = 0;
+    size_t pending = 0;
+    bool hedge_done = (replicas.size() < 2);
+
+    int ep = ::epoll_create1(EPOLL_CLOEXEC);
+
+    if (ep < 0)
+        throw error::system_error("could not epoll_create1() : ");
+
+    struct closer {
+        int fd;
+        closer(int f) : fd(f) {}
+        ~closer() { ::close(fd); }
+    } c(ep);
+
+    std::vector<unsigned char> tmp(clientserver::buffer<clientserver::client_socket>::BUFF_SIZE);
+    struct epoll_event events[2];
+
+    while (1) {
+
+        unsigned long long now = clientserver::monotonic_usec();
+
+        //  ;  --     ,   .
+        bool want = (started == 0 || (!hedge_done && (now >= hedge_at || pending == 0)));
+
+        if (want && started < 2) {
+
+            if (started == 1) {
+                hedge_done = true;
+
+                if (!h.take()) {
+                    if (pending == 0)
+                        break;
+
+                    continue;
+                }
+            }
+
+            size_t i = started++;
+            target[i] = (first + i) % replicas.size();
+            sent[i] = clientserver::monotonic_usec();
+
+            try {
+                detail::start_request_(pool, replicas[target[i]], req, conns[i], in[i], ep, i);
+                ++pending;
+
+            } catch (std::exception& e) {
+                replies[i].status = SHARD_ERROR;
+                replies[i].error = e.what();
+                conns[i] = client_t();
+            }
+
+            continue;
+        }
+
+        if (pending == 0)
+            break;
+
+        if (now >= deadline)
+            break;
+
+        unsigned long long until = (!hedge_done && hedge_at < deadline ? hedge_at : deadline);
+        int wait = (until > now ? (until - now + 999) / 1000 : 0);
+
+        int n = ::epoll_wait(ep, events, 2, wait);
+
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+
+            throw error::system_error("could not epoll_wait() : ");
+        }
+
+        for (int j = 0; j < n; ++j) {
+
+            size_t i = events[j].data.u64;
+            bool reusable = false;
+
+            try {
+
+                if (!detail::step_(conns[i], in[i], replies[i], tmp, reusable, ep, i))
+                    continue;
+
+                replies[i].status = SHARD_OK;
+                replies[i].usec = clientserver::monotonic_usec() - start;
+
+            } catch (std::exception& e) {
+                replies[i].status = SHARD_ERROR;
+                replies[i].error = e.what();
+            }
+
+            detail::finish_request_(pool, replicas[target[i]], conns[i], ep, replies[i].fields, reusable);
+            --pending;
+        }
+
+        //    .
+        for (size_t i = 0; i < started; ++i) {
+
+            if (replies[i].status != SHARD_OK)
+                continue;
+
+            //  --     ,    .
+            h.observe(replies[i].usec - (sent[i] - start));
+
+            if (i == 1) {
+                h.won.add();
+
+                //      :   --  ,  . 
+                //      ,  delay()   .
+                if (replies[0].status == SHARD_PENDING)
+                    h.observe(clientserver::monotonic_usec() - sent[0]);
+            }
+
+            out = replies[i];
+            return out.status;
+        }
+    }
+
+    //  :  ,  .  ,    , --
+    //  , .
+    if (started > 0 && replies[0].status == SHARD_PENDING)
+        h.observe(clientserver::monotonic_usec() - sent[0]);
+
+    out.status = SHARD_TIMEOUT;
+    out.error = "deadline exceeded";
+
+    for (size_t i = 0; i < started; ++i) {
+        if (replies[i].status == SHARD_ERROR && pending == 0) {
+            out.status = SHARD_ERROR;
+            out.error = replies[i].error;
+        }
+    }
+
+    return out.status;
+}
+
+}
+
+/*
+
+    :
+
+     static httpd::http1_1<httpd::serialized_client> pool(1000, 1000, 100);
+
+     //   p95,   5%  ,   2  200 .
+     static httpd::hedging hedge(95, 0.05, 2, 200);
+
+     httpd::shard_reply<result> reply;
+
+     if (httpd::hedged_get(pool, hedge, replicas, req, reply, 500) == httpd::SHARD_OK)
+         use(reply.data);
+
+ */
+
+
+#endif
@@ -6,6 +6,7 @@
 #include "files/serialization.h"
 #include "addresses.h"
 #include "lockfree/aux_.h"
+#include "metrics/metrics.h"
 
 #include "httpd.h"
 #include <sys/epoll.h>
@@ -44,11 +45,21 @@ public:
     std::string m_host;
     int m_port;
 
-    client(const std::string& host, int port, int rtimeout = 0, int stimeout = 0) : 
-        m_sock(clientserver::connect(host, port, rtimeout, stimeout)),
+    client(const std::string& host, int port, int rtimeout = 0, int stimeout = 0, unsigned int ctimeout = 0) : 
+        m_sock(clientserver::connect(host, port, rtimeout, stimeout, ctimeout)),
         m_host(host),
         m_port(port) {}
 
+    //     al (. clientserver::connect_race()).
+    client(const addresslist& al, unsigned int ctimeout, int rtimeout = 0, int stimeout = 0, unsigned int stagger = 0) :
+        m_port(0) {
+
+        size_t n = 0;
+        m_sock = clientserver::connect_race(al, ctimeout, rtimeout, stimeout, stagger, &n);
+        m_host = al[n].host;
+        m_port = al[n].port;
+    }
+
     typedef std::map<std::string,std::vector<std::string> > fields_t;
 
 protected:
@@ -59,14 +70,13 @@ protected:
 
 	head.clear();
 
-	while (1) {
-	    unsigned char c;
-	    m_sock >> c;
+	std::string line;
+	m_sock->read_until('\n', line);
 
-	    if (c == '\r') continue;
-	    if (c == '\n') break;
+	for (std::string::const_iterator i = line.begin(); i != line.end(); ++i) {
+	    if (*i == '\r' || *i == '\n') continue;
 
-	    head += c;
+	    head += *i;
 	}
 
 	request tmp;
@@ -89,11 +99,10 @@ protected:
 	    }
 
 	    while (len != 0) {
-		unsigned char c;
-		m_sock >> c;
-		body += c;
+		std::pair<const unsigned char*, size_t> s = m_sock->read_some(len > 0 ? len : m_sock->BUFF_SIZE);
+		body.append((const char*)s.first, s.second);
 
-		if (len > 0) len--;
+		if (len > 0) len -= s.second;
 	    }
 
 	} catch (clientserver::eof_exception& e) {
@@ -144,8 +153,8 @@ public:
 
     persistent_client_() : CLIENT(false) {}
 
-    persistent_client_(const std::string& h, int p, int rtimeout = 0, int stimeout = 0) : 
-        CLIENT(h, p, rtimeout, stimeout) {}
+    persistent_client_(const std::string& h, int p, int rtimeout = 0, int stimeout = 0, unsigned int ctimeout = 0) : 
+        CLIENT(h, p, rtimeout, stimeout, ctimeout) {}
 
 
     operator bool() const { return (bool)m_sock; }
@@ -282,8 +291,8 @@ public:
 
     serialized_client(bool) : client(false) {}
 
-    serialized_client(const std::string& h, int p, int rtimeout = 0, int stimeout = 0) :
-        client(h, p, rtimeout, stimeout) {}
+    serialized_client(const std::string& h, int p, int rtimeout = 0, int stimeout = 0, unsigned int ctimeout = 0) :
+        client(h, p, rtimeout, stimeout, ctimeout) {}
 
     template <typename T>
     void send_get_serialized(const request& req, T& out) {
@@ -337,8 +346,8 @@ public:
     using client::send;
 
     raw_serialized_client(bool) : serialized_client(false) {}
-    raw_serialized_client(const std::string& h, int p, int rtimeout = 0, int stimeout = 0) :
-        serialized_client(h, p, rtimeout, stimeout) {}
+    raw_serialized_client(const std::string& h, int p, int rtimeout = 0, int stimeout = 0, unsigned int ctimeout = 0) :
+        serialized_client(h, p, rtimeout, stimeout, ctimeout) {}
 
     void send_header(const request& req) {
         fields_t fields;
@@ -376,8 +385,8 @@ public:
     using client::m_host;
     using client::m_port;
 
-    serialized_post_client(const std::string& h, int p, int rtimeout = 0, int stimeout = 0) :
-        raw_serialized_client(h, p, rtimeout, stimeout) {}
+    serialized_post_client(const std::string& h, int p, int rtimeout = 0, int stimeout = 0, unsigned int ctimeout = 0) :
+        raw_serialized_client(h, p, rtimeout, stimeout, ctimeout) {}
 
     template <typename T>
     void send_serialized(request& req, const T& out) {
@@ -431,8 +440,8 @@ public:
     using serialized_post_client::send_serialized;
     using serialized_post_client::send_serialized_n;
 
-    full_serialization_client(const std::string& h, int p, int rtimeout = 0, int stimeout = 0) :
-        serialized_post_client(h, p, rtimeout, stimeout) {}
+    full_serialization_client(const std::string& h, int p, int rtimeout = 0, int stimeout = 0, unsigned int ctimeout = 0) :
+        serialized_post_client(h, p, rtimeout, stimeout, ctimeout) {}
 
     template <typename T, typename F>
     void send_serialized_f(request& req, const T& out, F f) {
@@ -472,15 +481,35 @@ private:
     std::map<address, std::list<client> > connects;
     boost::mutex m_lock;
 
+    //      (. metrics/metrics.h).
+    static metrics::counter& hits_() {
+        static metrics::counter& ret = metrics::get_counter("httpd_pool_hits_total", "Keepalive connections taken from the pool.");
+        return ret;
+    }
+
+    static metrics::counter& misses_() {
+        static metrics::counter& ret = metrics::get_counter("httpd_pool_misses_total", "New connections opened because the pool had none alive.");
+        return ret;
+    }
+
+    static metrics::gauge& pooled_() {
+        static metrics::gauge& ret = metrics::get_gauge("httpd_pool_connections", "Idle keepalive connections in the pool.");
+        return ret;
+    }
+
 public:
     unsigned int rcv_timeout;
     unsigned int snd_timeout;
 
+    //   connect()  ; 0 --   .
+    unsigned int connect_timeout;
+
     unsigned int m_pool_size;
 
-    http1_1(unsigned int r = 0, unsigned int s = 0)
+    http1_1(unsigned int r = 0, unsigned int s = 0, unsigned int c = 0)
             : rcv_timeout(r)
             , snd_timeout(s)
+            , connect_timeout(c)
             , m_pool_size(0) { }
 
     client get(const address& a, unsigned int& stat_connects_count, unsigned int& stat_pool_size,
@@ -498,6 +527,7 @@ public:
 
                 lf::atomic_dec(&m_pool_size);
                 lf::cas(&stat_pool_size, stat_pool_size, m_pool_size);
+                pooled_().add(-1);
         } else {
                 lf::atomic_inc(&stat_connects_count); //      .       RPS 
                 lf::cas(&stat_pool_size, stat_pool_size, m_pool_size);
@@ -505,18 +535,21 @@ public:
         }
 
         if (!ret) {
-            return client(a.host, a.port, rtimeout, stimeout);
+            misses_().add();
+            return client(a.host, a.port, rtimeout, stimeout, connect_timeout);
         } else {
             try {
                 ret.m_sock->m_obj->check_peer_state();
+                hits_().add();
                 return ret;
 
             } catch (const std::runtime_error& e) {
 
                 logger::log(logger::DEBUG) << "bad client in pool found: " << e.what();
                 lf::atomic_inc( &stat_connects_count );
+                misses_().add();
 
-                return client(a.host, a.port, rtimeout, stimeout);
+                return client(a.host, a.port, rtimeout, stimeout, connect_timeout);
             }
         }
     }
@@ -525,6 +558,51 @@ public:
         return get(a, stat_connects_count, stat_pool_size, rcv_timeout, snd_timeout);
     }
 
+    //       client,  :   
+    // ,   (. clientserver::connect_nowait(), fanout.h),  
+    //   attach().
+    client get_pooled(const address& a) {
+
+        client ret;
+
+        {
+            boost::mutex::scoped_lock lock(m_lock);
+
+            auto it = connects.find(a);
+            if (it != connects.end() && !(it->second.empty())) {
+                ret = it->second.front();
+                it->second.pop_front();
+
+                lf::atomic_dec(&m_pool_size);
+                pooled_().add(-1);
+            }
+        }
+
+        if (!ret)
+            return ret;
+
+        try {
+            ret.m_sock->m_obj->check_peer_state();
+            hits_().add();
+            return ret;
+
+        } catch (const std::runtime_error& e) {
+            logger::log(logger::DEBUG) << "bad client in pool found: " << e.what();
+            return client();
+        }
+    }
+
+    client attach(const address& a, clientserver::client_buffer sock) {
+
+        misses_().add();
+
+        client ret;
+        ret.m_sock = sock;
+        ret.m_host = a.host;
+        ret.m_port = a.port;
+        return ret;
+    }
+
     void put(const address& a, client c, const typename CLIENT::fields_t& fields) {
         if (c) {
 
@@ -544,6 +622,7 @@ public:
 
             connects[a].push_back(c);
                 lf::atomic_inc(&m_pool_size);
+                pooled_().add(1);
             }
         }
     }
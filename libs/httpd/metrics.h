@@ -0,0 +1,50 @@
+#ifndef __HTTPD_METRICS_H
+#define __HTTPD_METRICS_H
+
+
+#include <string>
+
+#include "httpd.h"
+#include "metrics/metrics.h"
+
+
+namespace httpd {
+
+
+//   (. metrics/metrics.h)   Prometheus,   path.
+//  false,      --     .
+
+inline bool serve_metrics(const request& req, responder& resp, const std::string& path = "/metrics") {
+
+    if (req.path != path)
+        return false;
+
+    resp.data.clear();
+    metrics::render(resp.data);
+
+    resp.set_field("content-type", "text/plain; version=0.0.4");
+    resp.code = "200 OK";
+    return true;
+}
+
+}
+
+/*
+
+    :
+
+     void service(clientserver::service_buffer sock) {
+        ...
+        httpd::responder resp(sock, req);
+
+        if (!httpd::serve_metrics(req, resp))
+            process(req, resp);
+
+        resp.send();
+        ...
+     }
+
+ */
+
+
+#endif
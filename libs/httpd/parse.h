@@ -2,13 +2,34 @@
 #define __HTTPD_PARSE_H
 
 #include <string>
+#include <string.h>
 #include <strings.h>
 
 #include "httpd/request.h"
+#include "clientserver/clientserver.h"
+#include "clientserver/evented.h"
 
 namespace httpd {
 
 
+//     ;     ,    .
+struct line_source {
+    const std::string& s;
+    size_t i;
+
+    line_source(const std::string& s_) : s(s_), i(0) {}
+
+    line_source& operator>>(unsigned char& c) {
+        if (i == s.size())
+            throw clientserver::eof_exception();
+
+        c = s[i];
+        ++i;
+        return *this;
+    }
+};
+
+
 
 
 
@@ -114,7 +135,7 @@ inline std::string get_domain_from_url(const std::string& url) {
 }
 
 template <typename BUF>
-inline void parse_query(BUF sock, request& out, int nlen = -1) {
+inline void parse_query(BUF& sock, request& out, int nlen = -1) {
 
     int n = 0;
 
@@ -184,11 +205,17 @@ inline void parse_query(BUF sock, request& out, int nlen = -1) {
 
 
 template <typename BUF>
-inline void parse_request_line(BUF sock, request& out) {
+inline void parse_request_line(BUF& sock, request& out) {
     out.version.clear();
     out.method.clear();
     out.path.clear();
 
+    //  ,  memchr  .
+    std::string line;
+    sock->read_until('\n', line);
+
+    line_source src(line);
+
     unsigned char c;
     enum state_ { MET, URI, VER } state = MET;
 
@@ -196,7 +223,7 @@ inline void parse_request_line(BUF sock, request& out) {
     //       ,    .
 
     while (1) {
-	sock >> c;
+	src >> c;
 
 	if (c == ' ') {
 	    if (state == MET) state = URI;
@@ -212,7 +239,7 @@ inline void parse_request_line(BUF sock, request& out) {
 	else if (state == URI) {
 
 	    if (c == '?') {
-		parse_query<BUF>(sock, out);
+		parse_query<line_source>(src, out);
 		state = VER;
 	    } else {
 		out.path += c;
@@ -225,12 +252,13 @@ inline void parse_request_line(BUF sock, request& out) {
 /*          ;   . */
 
 template <typename BUF>
-inline void parse_request_fields(BUF sock, request& out) {
+inline void parse_request_fields(BUF& sock, request& out) {
     out.fields.clear();
 
     unsigned char c;
 
     std::string key_prev;
+    std::string line;
 
     while (1) {
 	std::string key;
@@ -239,8 +267,13 @@ inline void parse_request_fields(BUF sock, request& out) {
 
 	enum state_ { INIT, KEY, VAL, VAL_SP, COLON_SP } state = INIT;
 
-	while (1) {
-	    sock >> c;
+	line.clear();
+	sock->read_until('\n', line);
+
+	out.fields_raw += line;
+
+	for (std::string::const_iterator i = line.begin(); i != line.end(); ++i) {
+	    c = *i;
 
 	    if (state == INIT) {
 		if (c == ' ') {
@@ -250,8 +283,6 @@ inline void parse_request_fields(BUF sock, request& out) {
 		}
 	    }
 
-	    out.fields_raw += c;
-
 	    if (c == '\r') continue;
 	    if (c == '\n') break;
 
@@ -339,14 +370,68 @@ inline void parse_request_fields(BUF sock, request& out) {
 }
     
 
+//    (. clientserver/timer_wheel.h).      .
+
+template <typename BUF>
+inline void reading_(BUF&) {}
+
+template <typename BUF>
+inline void handling_(BUF&) {}
+
+inline void reading_(clientserver::service_buffer& sock) {
+    sock->m_obj->timer.reading();
+}
+
+inline void handling_(clientserver::service_buffer& sock) {
+    sock->m_obj->timer.handling();
+}
+
+
+//    :  shared_ptr --     .
 template <typename BUF>
-inline void parse_request(BUF sock, request& out) {
+inline void parse_request(BUF& sock, request& out) {
 
     parse_request_line<BUF>(sock, out);
+    reading_(sock);
+
     parse_request_fields<BUF>(sock, out);
+    handling_(sock);
+}
+
+
+//  ( ) :   ,     .
+
+template <typename BUF>
+inline void parse_query(const BUF& sock, request& out, int nlen = -1) {
+    BUF tmp(sock);
+    parse_query(tmp, out, nlen);
+}
+
+template <typename BUF>
+inline void parse_request_line(const BUF& sock, request& out) {
+    BUF tmp(sock);
+    parse_request_line(tmp, out);
+}
+
+template <typename BUF>
+inline void parse_request_fields(const BUF& sock, request& out) {
+    BUF tmp(sock);
+    parse_request_fields(tmp, out);
+}
+
+template <typename BUF>
+inline void parse_request(const BUF& sock, request& out) {
+    BUF tmp(sock);
+    parse_request(tmp, out);
 }
 
 
+//   clientserver::serve_evented:      .
+// (    .)
+
+typedef clientserver::head_complete request_head_complete;
+
+
 }
 
 
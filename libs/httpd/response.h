@@ -8,6 +8,7 @@
 #include "files/files_format.h"
 #include "files/serialization_save.h"
 #include "clientserver/clientserver.h"
+#include "clientserver/zerocopy.h"
 
 #include <string>
 #include <vector>
@@ -143,13 +144,48 @@ struct responder : public response::headers, public files::fmt {
 	    std::string tmp;
 	    headers_string(tmp);
 
+	    unsigned long long start = clientserver::monotonic_usec();
+
+	    //    --  sendmsg().
+	    sock->cork();
 	    sock << tmp;
-	    sock << data;
-            data.clear ();
+	    sock->take(data);
+	    sock->send_pending();
             sent = true;
+
+            clientserver::stats::stage_write().observe(clientserver::monotonic_usec() - start);
+
+            //   --   ,    .
+            sock->m_obj->timer.idle();
+            sock->release();
 	}
     }
 
+    //  --   ,    userspace (. clientserver/zerocopy.h).
+    void send_file(files::file& f, off_t offset, size_t len) {
+	if (sent)
+	    return;
+
+	set_content_length(len);
+
+	std::string tmp;
+	headers_string(tmp);
+
+	sock->cork();
+	sock << tmp;
+	data.clear();
+	sent = true;
+
+	if (clientserver::send_file(sock, f, offset, len) < len) {
+	    //     --    .
+	    should_close = true;
+	    throw std::runtime_error("send_file(): file is shorter than promised");
+	}
+
+        sock->m_obj->timer.idle();
+        sock->release();
+    }
+
     void set_body(const std::string& b) {
 	data = b;
     }
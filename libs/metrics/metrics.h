@@ -0,0 +1,405 @@
+#ifndef __METRICS_METRICS_H
+#define __METRICS_METRICS_H
+
+
+#include <string>
+#include <map>
+#include <stdexcept>
+
+#include <boost/thread/mutex.hpp>
+
+#include "files/files_format.h"
+#include "lockfree/aux_.h"
+
+
+namespace metrics {
+
+
+/*
+ *  : ,     .
+ *
+ *     (get_counter()  ..)     ;
+ *      ,  .   
+ *      Prometheus (. render(), httpd/metrics.h).
+ *
+ *    --   Prometheus;     :
+ * get_histogram("http_stage_seconds", "...", "stage=\"read\"").
+ */
+
+
+class metric {
+public:
+    virtual void render(std::string& out, const std::string& name, const std::string& labels) = 0;
+    virtual ~metric() {}
+};
+
+
+namespace {
+
+//      :     -.
+inline unsigned int stripe_(unsigned int stripes) {
+
+    static unsigned int next = 0;
+    static __thread unsigned int mine = 0;
+
+    if (mine == 0)
+        mine = lockfree::atomic_add(&next, 1U);
+
+    return mine % stripes;
+}
+
+inline void series_(std::string& out, const std::string& name, const std::string& labels) {
+
+    out += name;
+
+    if (!labels.empty()) {
+        out += '{';
+        out += labels;
+        out += '}';
+    }
+
+    out += ' ';
+}
+
+}
+
+
+//  .     --   -  .
+
+class counter : public metric {
+
+    static const unsigned int STRIPES = 16;
+
+    struct cell {
+        unsigned long v;
+        char pad[64 - sizeof(unsigned long)];
+    };
+
+    cell cells[STRIPES];
+
+public:
+
+    counter() {
+        for (unsigned int i = 0; i < STRIPES; ++i)
+            cells[i].v = 0;
+    }
+
+    void add(unsigned long n = 1) {
+        lockfree::atomic_add(&(cells[stripe_(STRIPES)].v), n);
+    }
+
+    unsigned long value() {
+
+        unsigned long ret = 0;
+
+        for (unsigned int i = 0; i < STRIPES; ++i)
+            ret += lockfree::atomic_add(&(cells[i].v), 0UL);
+
+        return ret;
+    }
+
+    void render(std::string& out, const std::string& name, const std::string& labels) {
+        series_(out, name, labels);
+        files::format(out, value());
+        out += '\n';
+    }
+};
+
+
+//  :  ,    ..
+
+class gauge : public metric {
+
+    long v;
+
+public:
+
+    gauge() : v(0) {}
+
+    void add(long n) {
+        lockfree::atomic_add(&v, n);
+    }
+
+    void set(long n) {
+
+        long old = v;
+
+        while (!lockfree::cas(&v, old, n))
+            old = v;
+    }
+
+    long value() {
+        return lockfree::atomic_add(&v, 0L);
+    }
+
+    void render(std::string& out, const std::string& name, const std::string& labels) {
+        series_(out, name, labels);
+        files::format(out, value());
+        out += '\n';
+    }
+};
+
+
+//    , -:   
+//   SUB  ,      1/SUB  .
+//  (Prometheus)   .
+
+class histogram : public metric {
+
+    static const unsigned int SUB_BITS = 2;
+    static const unsigned int SUB = 1 << SUB_BITS;
+    static const unsigned int BUCKETS = 32 * SUB;
+
+    unsigned long buckets[BUCKETS];
+    unsigned long long m_sum;
+    unsigned long m_count;
+
+public:
+
+    static unsigned int index(unsigned long long v) {
+
+        if (v < SUB)
+            return v;
+
+        unsigned int e = 63 - __builtin_clzll(v);
+        unsigned int ret = (e - SUB_BITS + 1) * SUB + ((v >> (e - SUB_BITS)) & (SUB - 1));
+
+        return (ret < BUCKETS ? ret : BUCKETS - 1);
+    }
+
+    //    i.
+    static unsigned long long lower(unsigned int i) {
+
+        if (i < SUB)
+            return i;
+
+        unsigned int e = i / SUB + SUB_BITS - 1;
+        return (unsigned long long)(SUB + i % SUB) << (e - SUB_BITS);
+    }
+
+    static unsigned long long upper(unsigned int i) {
+        return lower(i + 1);
+    }
+
+    histogram() : m_sum(0), m_count(0) {
+        for (unsigned int i = 0; i < BUCKETS; ++i)
+            buckets[i] = 0;
+    }
+
+    void observe(unsigned long long usec) {
+        lockfree::atomic_add(&(buckets[index(usec)]), 1UL);
+        lockfree::atomic_add(&m_sum, usec);
+        lockfree::atomic_add(&m_count, 1UL);
+    }
+
+    unsigned long count() {
+        return lockfree::atomic_add(&m_count, 0UL);
+    }
+
+    unsigned long long sum() {
+        return lockfree::atomic_add(&m_sum, 0ULL);
+    }
+
+    // ,    (. httpd/hedge.h).  ,  
+    //  0, --    ,      .
+    //   Prometheus  :    .
+    void reset() {
+
+        for (unsigned int i = 0; i < BUCKETS; ++i)
+            lockfree::atomic_add(&(buckets[i]), -lockfree::atomic_add(&(buckets[i]), 0UL));
+
+        lockfree::atomic_add(&m_sum, -lockfree::atomic_add(&m_sum, 0ULL));
+        lockfree::atomic_add(&m_count, -lockfree::atomic_add(&m_count, 0UL));
+    }
+
+    //  p-  (0 < p <= 100) ,  . 0 --   .
+    //  also --    .
+    unsigned long long percentile(double p, histogram* also = NULL) {
+
+        unsigned long tmp[BUCKETS];
+        unsigned long total = 0;
+
+        for (unsigned int i = 0; i < BUCKETS; ++i) {
+            tmp[i] = lockfree::atomic_add(&(buckets[i]), 0UL);
+
+            if (also != NULL)
+                tmp[i] += lockfree::atomic_add(&(also->buckets[i]), 0UL);
+
+            total += tmp[i];
+        }
+
+        if (total == 0)
+            return 0;
+
+        unsigned long rank = (unsigned long)(total * p / 100.0);
+        if (rank >= total) rank = total - 1;
+
+        unsigned long seen = 0;
+
+        for (unsigned int i = 0; i < BUCKETS; ++i) {
+            seen += tmp[i];
+
+            if (seen > rank)
+                return upper(i);
+        }
+
+        return upper(BUCKETS - 1);
+    }
+
+    void render(std::string& out, const std::string& name, const std::string& labels) {
+
+        unsigned long tmp[BUCKETS];
+        unsigned int last = 0;
+
+        for (unsigned int i = 0; i < BUCKETS; ++i) {
+            tmp[i] = lockfree::atomic_add(&(buckets[i]), 0UL);
+
+            if (tmp[i] > 0)
+                last = i;
+        }
+
+        std::string l = labels;
+        if (!l.empty()) l += ',';
+
+        unsigned long cumulative = 0;
+
+        //       ,   .
+        for (unsigned int i = 0; i <= last; ++i) {
+
+            cumulative += tmp[i];
+
+            out += name;
+            out += "_bucket{";
+            out += l;
+            out += "le=\"";
+            files::format_real(out, upper(i) / 1000000.0, "", 6);
+            out += "\"} ";
+            files::format(out, cumulative);
+            out += '\n';
+        }
+
+        out += name;
+        out += "_bucket{";
+        out += l;
+        out += "le=\"+Inf\"} ";
+        files::format(out, count());
+        out += '\n';
+
+        series_(out, name + "_sum", labels);
+        files::format_real(out, sum() / 1000000.0, "", 6);
+        out += '\n';
+
+        series_(out, name + "_count", labels);
+        files::format(out, count());
+        out += '\n';
+    }
+};
+
+
+
+class registry {
+
+    struct family {
+        std::string type;
+        std::string help;
+        std::map<std::string, metric*> series;
+    };
+
+    std::map<std::string, family> families;
+    boost::mutex m_lock;
+
+    template <typename M>
+    M& get_(const std::string& name, const std::string& type, const std::string& help, const std::string& labels) {
+
+        boost::mutex::scoped_lock l(m_lock);
+
+        family& f = families[name];
+
+        if (f.type.empty()) {
+            f.type = type;
+            f.help = help;
+
+        } else if (f.type != type) {
+            throw std::runtime_error("metrics: " + name + " is already a " + f.type);
+        }
+
+        metric*& m = f.series[labels];
+
+        if (m == NULL)
+            m = new M;
+
+        return *((M*)m);
+    }
+
+public:
+
+    static registry& global() {
+        static registry ret;
+        return ret;
+    }
+
+    counter& get_counter(const std::string& name, const std::string& help, const std::string& labels = "") {
+        return get_<counter>(name, "counter", help, labels);
+    }
+
+    gauge& get_gauge(const std::string& name, const std::string& help, const std::string& labels = "") {
+        return get_<gauge>(name, "gauge", help, labels);
+    }
+
+    histogram& get_histogram(const std::string& name, const std::string& help, const std::string& labels = "") {
+        return get_<histogram>(name, "histogram", help, labels);
+    }
+
+    //      Prometheus.
+    void render(std::string& out) {
+
+        boost::mutex::scoped_lock l(m_lock);
+
+        for (std::map<std::string, family>::iterator i = families.begin(); i != families.end(); ++i) {
+
+            out += "# HELP " + i->first + " " + i->second.help + "\n";
+            out += "# TYPE " + i->first + " " + i->second.type + "\n";
+
+            for (std::map<std::string, metric*>::iterator j = i->second.series.begin(); j != i->second.series.end(); ++j)
+                j->second->render(out, i->first, j->first);
+        }
+    }
+};
+
+
+inline counter& get_counter(const std::string& name, const std::string& help, const std::string& labels = "") {
+    return registry::global().get_counter(name, help, labels);
+}
+
+inline gauge& get_gauge(const std::string& name, const std::string& help, const std::string& labels = "") {
+    return registry::global().get_gauge(name, help, labels);
+}
+
+inline histogram& get_histogram(const std::string& name, const std::string& help, const std::string& labels = "") {
+    return registry::global().get_histogram(name, help, labels);
+}
+
+inline void render(std::string& out) {
+    registry::global().render(out);
+}
+
+}
+
+/*
+
+    :
+
+     static metrics::counter& requests = metrics::get_counter("app_requests_total", "Requests served.");
+     static metrics::histogram& latency = metrics::get_histogram("app_latency_seconds", "Request latency.");
+
+     requests.add();
+     latency.observe(usec);
+
+     logger::log(logger::INFO) << "p99 " << latency.percentile(99) << " us";
+
+     -- . httpd/metrics.h.
+
+ */
+
+
+#endif
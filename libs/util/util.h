@@ -98,13 +98,15 @@ inline void unlink_recursively(const std::string& path) {
 
 
 //  .
+// takeover:      (. clientserver/handoff.h),  pidfile .
 
-inline void daemonize(const std::string& pidfile, const std::string& info_log, const std::string& error_log, bool do_daemon = true) {
+inline void daemonize(const std::string& pidfile, const std::string& info_log, const std::string& error_log, bool do_daemon = true,
+                      bool takeover = false) {
     pid_t pid, sid;
 
     struct stat tmp;
 
-    if (::stat(pidfile.c_str(), &tmp) >= 0) {
+    if (!takeover && ::stat(pidfile.c_str(), &tmp) >= 0) {
         logger::log(logger::ERROR) << "Could not daemonize: pidfile '" + pidfile + "' already exists.";
         ::exit(1);
     }
@@ -131,6 +133,9 @@ inline void daemonize(const std::string& pidfile, const std::string& info_log, c
         }
     }
 
+    if (takeover)
+        ::unlink(pidfile.c_str());
+
     try {
         files::file pf = files::open(pidfile);
         std::string ptmp;